@@ -0,0 +1,143 @@
+// Banco de pruebas de libhuffman con muchos buffers pequeños: comprime y
+// descomprime N cargas de cada tamaño en el mismo proceso, reutilizando un
+// único contexto de cada tipo, y comprueba que cada una vuelve intacta.
+//
+//   ./bench/bench_buffers [-n cargas] [-s bytes,bytes,...]
+//
+// Informa, por tamaño, microsegundos por carga y MB/s en cada sentido y la
+// razón de compresión. Devuelve distinto de cero si alguna carga no vuelve
+// igual.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../huffman_lib.h"
+
+#define DEFAULT_COUNT 20000
+#define MAX_SIZES     16
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Texto de palabras con frecuencias sesgadas, distinto en cada carga
+static void fillPayload(unsigned char* out, size_t size, uint64_t* seed) {
+    static const char* const words[] = {
+        "de", "la", "que", "el", "en", "y", "a", "los", "se", "del", "las", "un",
+        "por", "con", "no", "una", "su", "para", "es", "al", "lo", "como", "más",
+        "compresión", "árbol", "bloque", "código", "tabla", "frecuencia", "archivo",
+    };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+    size_t pos = 0;
+    while (pos < size) {
+        *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t r = *seed >> 33;
+        const char* w = words[(r % wordCount) * (r % wordCount) / wordCount];
+        for (const char* p = w; *p && pos < size; p++) out[pos++] = (unsigned char)*p;
+        if (pos < size) out[pos++] = (r & 0xF) == 0 ? '\n' : ' ';
+    }
+}
+
+static int parseSizes(char* list, size_t sizes[MAX_SIZES]) {
+    int n = 0;
+    for (char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        long v = atol(tok);
+        if (v <= 0 || n == MAX_SIZES) return -1;
+        sizes[n++] = (size_t)v;
+    }
+    return n;
+}
+
+static int benchSize(size_t size, int count, struct HuffmanCompressor* c,
+                     struct HuffmanDecompressor* d) {
+    size_t bound = compressBound(size, c->blockSize);
+    unsigned char* inputs = malloc(size * (size_t)count);
+    unsigned char* packed = malloc(bound * (size_t)count);
+    long long* packedLen = malloc((size_t)count * sizeof(long long));
+    unsigned char* back = malloc(size);
+    if (!inputs || !packed || !packedLen || !back) {
+        perror("malloc");
+        free(inputs);
+        free(packed);
+        free(packedLen);
+        free(back);
+        return 1;
+    }
+
+    uint64_t seed = size;
+    for (int i = 0; i < count; i++) fillPayload(inputs + (size_t)i * size, size, &seed);
+
+    int failed = 0;
+    uint64_t totalPacked = 0;
+    double t0 = nowSeconds();
+    for (int i = 0; i < count; i++) {
+        packedLen[i] = compressBuffer(c, inputs + (size_t)i * size, size,
+                                      packed + (size_t)i * bound, bound);
+        if (packedLen[i] < 0) failed++;
+        else totalPacked += (uint64_t)packedLen[i];
+    }
+    double compressSec = nowSeconds() - t0;
+
+    t0 = nowSeconds();
+    for (int i = 0; i < count && !failed; i++) {
+        long long n = decompressBuffer(d, packed + (size_t)i * bound, (size_t)packedLen[i], back, size);
+        if (n != (long long)size || memcmp(back, inputs + (size_t)i * size, size) != 0) failed++;
+    }
+    double decompressSec = nowSeconds() - t0;
+
+    double mb = (double)size * count / 1e6;
+    printf("%8zu B x %6d  compresión %8.2f us/carga %8.1f MB/s  "
+           "descompresión %8.2f us/carga %8.1f MB/s  razón %.3f%s\n",
+           size, count, compressSec * 1e6 / count, mb / compressSec,
+           decompressSec * 1e6 / count, mb / decompressSec,
+           (double)totalPacked / ((double)size * count), failed ? "  ERROR" : "");
+
+    free(inputs);
+    free(packed);
+    free(packedLen);
+    free(back);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    int count = DEFAULT_COUNT;
+    size_t sizes[MAX_SIZES] = { 256, 4096, 65536 };
+    int sizeCount = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = atoi(optarg);
+            if (count < 1) {
+                fprintf(stderr, "Error: -n debe ser positivo\n");
+                return 1;
+            }
+            break;
+        case 's':
+            sizeCount = parseSizes(optarg, sizes);
+            if (sizeCount <= 0) {
+                fprintf(stderr, "Error: -s espera hasta %d tamaños en bytes separados por comas\n", MAX_SIZES);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Uso: %s [-n cargas] [-s bytes,bytes,...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct HuffmanCompressor c;
+    struct HuffmanDecompressor d;
+    if (initHuffmanCompressor(&c, 0, 0) != 0 || initHuffmanDecompressor(&d) != 0) return 1;
+
+    int status = 0;
+    for (int i = 0; i < sizeCount; i++) status |= benchSize(sizes[i], count, &c, &d);
+
+    freeHuffmanCompressor(&c);
+    freeHuffmanDecompressor(&d);
+    return status;
+}
@@ -0,0 +1,386 @@
+// Banco de pruebas de los motores: comprime y descomprime cada corpus con
+// huffman_compressor/huffman_decompressor y --engine=serial, threads y
+// processes (con -j N si se indica), repite cada ejecución
+// y da la mediana del tiempo de reloj, MB/s, la razón de compresión y el
+// mayor pico de RSS de un solo proceso (max_proc_rss_kb). Comprueba además
+// que la salida descomprimida es idéntica byte a byte a la entrada.
+//
+// max_proc_rss_kb no es la memoria total del motor: con processes cada
+// worker tiene su propio pico y la columna solo recoge el mayor, mientras
+// que con threads un único proceso lo contiene todo. No sirve para comparar
+// memoria entre motores, solo un mismo motor entre corpus o versiones.
+//
+//   ./bench/bench_engines [-r repeticiones] [-s MB,MB,...] [-f csv|json]
+//                         [-j N] [-d dir_binarios] [directorio_corpus]...
+//
+// Sin directorios usa textos/ y corpus generados de los tamaños de -s
+// (1,16,64 MB por defecto). Se ejecuta desde P1/ (make bench).
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../huffman_mmap.h"
+#include "../huffman_walk.h"
+
+#define MAX_REPS   101
+#define MAX_SIZES  16
+#define GEN_FILES  8
+
+// Valores de --engine; todos escriben el mismo formato
+static const char* const engines[] = { "serial", "threads", "processes" };
+#define ENGINE_COUNT ((int)(sizeof(engines) / sizeof(engines[0])))
+
+// Resultado de una fase (compresión o descompresión) de un motor
+struct PhaseResult {
+    double medianMs;
+    long   maxProcRssKb; // mayor ru_maxrss entre repeticiones (ver cabecera)
+    int    ok;          // todas las ejecuciones terminaron con 0
+};
+
+// ---------------- Ejecución de procesos -------------
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+// Ejecuta argv con stdout/stderr a /dev/null. Devuelve el código de salida
+// (-1 si no terminó normalmente) y deja el tiempo y el mayor RSS máximo de
+// un proceso: el del hijo o el de alguno de los suyos ya recogidos.
+static int runTimed(char* const argv[], double* ms, long* rssKb) {
+    double t0 = nowMs();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) == -1) {
+        if (errno != EINTR) {
+            perror("wait4");
+            return -1;
+        }
+    }
+    *ms = nowMs() - t0;
+    *rssKb = ru.ru_maxrss;  // KB en Linux; el máximo por proceso, no la suma
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int compareDouble(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double median(double* v, int n) {
+    qsort(v, (size_t)n, sizeof(double), compareDouble);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+// ---------------- Directorios temporales ------------
+static int removeEntry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void removeTree(const char* path) {
+    nftw(path, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// ---------------- Corpus generado --------------------
+// Texto sintético con palabras de un vocabulario fijo y distribución sesgada,
+// para que la razón de compresión se parezca a la de textos/. Los archivos
+// tienen tamaños distintos (proporcionales a 1..GEN_FILES) para que el
+// reparto entre trabajadores no sea trivial.
+static int generateCorpus(const char* dir, size_t totalBytes, unsigned seed) {
+    static const char* words[] = {
+        "de", "la", "que", "el", "en", "y", "a", "los", "se", "del", "las", "un",
+        "por", "con", "no", "una", "su", "para", "es", "al", "lo", "como", "más",
+        "the", "of", "and", "to", "in", "was", "he", "that", "it", "his", "her",
+        "huffman", "archivo", "compresor", "bloque", "tabla", "frecuencia",
+    };
+    const int wordCount = (int)(sizeof(words) / sizeof(words[0]));
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+    srand(seed);
+    size_t weightSum = (size_t)GEN_FILES * (GEN_FILES + 1) / 2;
+    for (int f = 0; f < GEN_FILES; f++) {
+        char path[4096];
+        int n = snprintf(path, sizeof(path), "%s/gen_%02d.txt", dir, f);
+        FILE* out = n > 0 && (size_t)n < sizeof(path) ? fopen(path, "wb") : NULL;
+        if (!out) return -1;
+        size_t target = totalBytes * (size_t)(f + 1) / weightSum;
+        size_t written = 0;
+        int column = 0;
+        while (written < target) {
+            // Zipf aproximado: las primeras palabras salen mucho más a menudo
+            int r = rand() % (wordCount * wordCount);
+            int w = 0;
+            while ((w + 1) * (w + 1) <= r) w++;
+            w = wordCount - 1 - w;
+            int len = fprintf(out, "%s", words[w]);
+            column += len;
+            written += (size_t)len;
+            char sep = column > 70 ? '\n' : (rand() % 12 == 0 ? ',' : ' ');
+            if (sep == '\n') column = 0;
+            fputc(sep, out);
+            written++;
+        }
+        if (fclose(out) != 0) return -1;
+    }
+    return 0;
+}
+
+// ---------------- Comprobación ida y vuelta ----------
+static int sameContents(const char* a, const char* b) {
+    struct MappedFile x, y;
+    if (mapFileReadOnly(a, &x, POSIX_MADV_SEQUENTIAL) != 0) return 0;
+    if (mapFileReadOnly(b, &y, POSIX_MADV_SEQUENTIAL) != 0) {
+        unmapFile(&x);
+        return 0;
+    }
+    int same = x.size == y.size && (x.size == 0 || memcmp(x.data, y.data, x.size) == 0);
+    unmapFile(&x);
+    unmapFile(&y);
+    return same;
+}
+
+static int verifyRoundTrip(const struct FileList* input, const char* outputDir) {
+    for (int i = 0; i < input->count; i++) {
+        char path[4096];
+        int n = snprintf(path, sizeof(path), "%s/%s", outputDir, input->entries[i].name);
+        if (n < 0 || (size_t)n >= sizeof(path) || !sameContents(input->entries[i].path, path)) return 0;
+    }
+    return 1;
+}
+
+// ---------------- Medición de un corpus --------------
+struct Options {
+    int reps;
+    int json;
+    const char* jobs;    // -j para threads y processes (NULL = uno por CPU)
+    const char* binDir;
+};
+
+static int firstRow = 1;
+
+// argv de un ejecutable: programa, --engine, [-j N], entrada y salida
+static void buildArgs(char* argv[7], const char* program, const char* engine, const char* jobs,
+                      const char* input, const char* output) {
+    int n = 0;
+    argv[n++] = (char*)program;
+    argv[n++] = (char*)engine;
+    if (jobs) {
+        argv[n++] = "-j";
+        argv[n++] = (char*)jobs;
+    }
+    argv[n++] = (char*)input;
+    argv[n++] = (char*)output;
+    argv[n] = NULL;
+}
+
+static void report(const struct Options* opt, const char* corpus, const char* engine,
+                   const char* phase, uint64_t inputBytes, uint64_t archiveBytes,
+                   const struct PhaseResult* r, int roundTrip) {
+    double ratio = inputBytes ? (double)archiveBytes / (double)inputBytes : 0.0;
+    double mbs = r->medianMs > 0 ? (double)inputBytes / (1024.0 * 1024.0) / (r->medianMs / 1e3) : 0.0;
+    if (opt->json) {
+        printf("%s  {\"corpus\": \"%s\", \"engine\": \"%s\", \"phase\": \"%s\", "
+               "\"input_bytes\": %llu, \"archive_bytes\": %llu, \"ratio\": %.4f, "
+               "\"median_ms\": %.2f, \"mb_s\": %.2f, \"max_proc_rss_kb\": %ld, "
+               "\"exit_ok\": %s, \"roundtrip\": %s}",
+               firstRow ? "" : ",\n", corpus, engine, phase,
+               (unsigned long long)inputBytes, (unsigned long long)archiveBytes, ratio,
+               r->medianMs, mbs, r->maxProcRssKb, r->ok ? "true" : "false",
+               roundTrip ? "true" : "false");
+    } else {
+        printf("%s,%s,%s,%llu,%llu,%.4f,%.2f,%.2f,%ld,%d,%d\n",
+               corpus, engine, phase, (unsigned long long)inputBytes,
+               (unsigned long long)archiveBytes, ratio, r->medianMs, mbs,
+               r->maxProcRssKb, r->ok, roundTrip);
+    }
+    firstRow = 0;
+    fflush(stdout);
+}
+
+// Mide los tres motores sobre 'corpusDir'. Devuelve el número de fallos
+// (ejecuciones con error o salidas distintas de la entrada).
+static int benchCorpus(const struct Options* opt, const char* label,
+                       const char* corpusDir, const char* workDir) {
+    struct FileList input;
+    if (walkDirectory(corpusDir, 1, &input) != 0 || input.count == 0) {
+        fprintf(stderr, "Error: No hay archivos .txt en %s\n", corpusDir);
+        return 1;
+    }
+    uint64_t inputBytes = 0;
+    for (int i = 0; i < input.count; i++) inputBytes += input.entries[i].size;
+
+    int failures = 0;
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        char compressor[4096], decompressor[4096], archive[4096], outputDir[4096], engine[64];
+        snprintf(compressor, sizeof(compressor), "%s/huffman_compressor", opt->binDir);
+        snprintf(decompressor, sizeof(decompressor), "%s/huffman_decompressor", opt->binDir);
+        snprintf(archive, sizeof(archive), "%s/%s.bin", workDir, engines[e]);
+        snprintf(outputDir, sizeof(outputDir), "%s/%s.out", workDir, engines[e]);
+        snprintf(engine, sizeof(engine), "--engine=%s", engines[e]);
+
+        // -j solo se pasa a los motores paralelos
+        const char* jobs = e != 0 ? opt->jobs : NULL;
+        char* cargv[7];
+        char* dargv[7];
+        buildArgs(cargv, compressor, engine, jobs, corpusDir, archive);
+        buildArgs(dargv, decompressor, engine, jobs, archive, outputDir);
+        double times[MAX_REPS];
+        struct PhaseResult comp = { 0, 0, 1 }, decomp = { 0, 0, 1 };
+
+        for (int r = 0; r < opt->reps; r++) {
+            long rss = 0;
+            if (runTimed(cargv, &times[r], &rss) != 0) comp.ok = 0;
+            if (rss > comp.maxProcRssKb) comp.maxProcRssKb = rss;
+        }
+        comp.medianMs = median(times, opt->reps);
+
+        struct stat st;
+        uint64_t archiveBytes = stat(archive, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+        int roundTrip = comp.ok;
+        for (int r = 0; r < opt->reps && comp.ok; r++) {
+            long rss = 0;
+            removeTree(outputDir);  // cada repetición escribe en un directorio vacío
+            if (runTimed(dargv, &times[r], &rss) != 0) decomp.ok = 0;
+            if (rss > decomp.maxProcRssKb) decomp.maxProcRssKb = rss;
+        }
+        if (comp.ok) {
+            decomp.medianMs = median(times, opt->reps);
+            roundTrip = decomp.ok && verifyRoundTrip(&input, outputDir);
+        } else {
+            decomp.ok = 0;
+        }
+
+        report(opt, label, engines[e], "compress", inputBytes, archiveBytes, &comp, roundTrip);
+        report(opt, label, engines[e], "decompress", inputBytes, archiveBytes, &decomp, roundTrip);
+        if (!roundTrip) {
+            fprintf(stderr, "Error: %s no reproduce %s byte a byte\n", engines[e], label);
+            failures++;
+        }
+
+        removeTree(outputDir);
+        remove(archive);
+    }
+    freeFileList(&input);
+    return failures;
+}
+
+// ---------------- Programa principal -----------------
+static int parseSizes(char* list, size_t sizes[MAX_SIZES]) {
+    int n = 0;
+    for (char* tok = strtok(list, ","); tok && n < MAX_SIZES; tok = strtok(NULL, ",")) {
+        long mb = atol(tok);
+        if (mb <= 0) return -1;
+        sizes[n++] = (size_t)mb;
+    }
+    return n;
+}
+
+int main(int argc, char* argv[]) {
+    struct Options opt = { 5, 0, NULL, "." };
+    size_t sizes[MAX_SIZES] = { 1, 16, 64 };
+    int sizeCount = 3;
+
+    int c;
+    while ((c = getopt(argc, argv, "r:s:f:j:d:")) != -1) {
+        switch (c) {
+        case 'r':
+            opt.reps = atoi(optarg);
+            if (opt.reps < 1 || opt.reps > MAX_REPS) {
+                fprintf(stderr, "Error: -r debe estar entre 1 y %d\n", MAX_REPS);
+                return 1;
+            }
+            break;
+        case 's':
+            sizeCount = parseSizes(optarg, sizes);
+            if (sizeCount < 0) {
+                fprintf(stderr, "Error: -s espera tamaños en MB separados por comas\n");
+                return 1;
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "json") == 0) opt.json = 1;
+            else if (strcmp(optarg, "csv") == 0) opt.json = 0;
+            else {
+                fprintf(stderr, "Error: -f debe ser csv o json\n");
+                return 1;
+            }
+            break;
+        case 'j':
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "Error: -j debe ser positivo\n");
+                return 1;
+            }
+            opt.jobs = optarg;
+            break;
+        case 'd':
+            opt.binDir = optarg;
+            break;
+        default:
+            fprintf(stderr, "Uso: %s [-r repeticiones] [-s MB,MB,...] [-f csv|json] "
+                            "[-j N] [-d dir_binarios] [directorio_corpus]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char workDir[] = "/tmp/huffman_bench_XXXXXX";
+    if (!mkdtemp(workDir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    if (opt.json) printf("[\n");
+    else printf("corpus,engine,phase,input_bytes,archive_bytes,ratio,median_ms,mb_s,max_proc_rss_kb,exit_ok,roundtrip\n");
+
+    int failures = 0;
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++)
+            failures += benchCorpus(&opt, argv[i], argv[i], workDir);
+    } else {
+        failures += benchCorpus(&opt, "textos", "textos", workDir);
+        for (int s = 0; s < sizeCount; s++) {
+            char label[64], dir[4096];
+            snprintf(label, sizeof(label), "gen_%zuMB", sizes[s]);
+            snprintf(dir, sizeof(dir), "%s/%s", workDir, label);
+            if (generateCorpus(dir, sizes[s] * 1024 * 1024, (unsigned)(s + 1)) != 0) {
+                fprintf(stderr, "Error: No se pudo generar el corpus %s\n", label);
+                failures++;
+            } else {
+                failures += benchCorpus(&opt, label, dir, workDir);
+            }
+            removeTree(dir);
+        }
+    }
+
+    if (opt.json) printf("\n]\n");
+    removeTree(workDir);
+    return failures ? 1 : 0;
+}
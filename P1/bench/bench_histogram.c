@@ -0,0 +1,104 @@
+// Microbenchmark del conteo de frecuencias: compara el bucle de un solo
+// histograma (buckets[p[k]]++) con countBytesScalar y countBytes.
+//
+//   ./bench/bench_histogram [MB] [archivo]...
+//
+// Sin archivos mide tres entradas sintéticas de MB megabytes (64 por
+// defecto): texto, rachas largas y bytes aleatorios. Informa el mejor de
+// REPS pases en GB/s y comprueba que los tres histogramas coinciden.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../huffman_codec.h"
+#include "../huffman_mmap.h"
+
+#define REPS 7
+
+typedef void (*CountFn)(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]);
+
+// El bucle que usaban los compresores antes de countBytes
+static void countBytesNaive(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]) {
+    for (size_t i = 0; i < size; i++) freq[in[i]]++;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double bestGBs(CountFn fn, const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]) {
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        memset(freq, 0, HUFF_SYMBOLS * sizeof(uint64_t));
+        double t0 = nowSeconds();
+        fn(in, size, freq);
+        double dt = nowSeconds() - t0;
+        if (dt < best) best = dt;
+    }
+    return best > 0 ? (double)size / best / 1e9 : 0.0;
+}
+
+static int benchBuffer(const char* label, const unsigned char* in, size_t size) {
+    static const struct { const char* name; CountFn fn; } kernels[] = {
+        { "naive",  countBytesNaive },
+        { "scalar", countBytesScalar },
+        { "auto",   countBytes },
+    };
+    uint64_t reference[HUFF_SYMBOLS], freq[HUFF_SYMBOLS];
+    int ok = 1;
+
+    printf("%-12s %8.1f MB", label, (double)size / (1024.0 * 1024.0));
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        double gbs = bestGBs(kernels[k].fn, in, size, k == 0 ? reference : freq);
+        if (k > 0 && memcmp(reference, freq, sizeof(freq)) != 0) ok = 0;
+        printf("  %s %6.2f GB/s", kernels[k].name, gbs);
+    }
+    printf("%s\n", ok ? "" : "  ERROR: histogramas distintos");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    size_t mb = argc > 1 ? (size_t)atol(argv[1]) : 64;
+    if (mb == 0) mb = 64;
+    int failed = 0;
+
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            struct MappedFile file;
+            if (mapFileReadOnly(argv[i], &file, POSIX_MADV_SEQUENTIAL) != 0) {
+                printf("Error: No se pudo abrir %s\n", argv[i]);
+                failed = 1;
+                continue;
+            }
+            failed |= benchBuffer(argv[i], file.data, file.size);
+            unmapFile(&file);
+        }
+        return failed;
+    }
+
+    size_t size = mb * 1024 * 1024;
+    unsigned char* buf = malloc(size);
+    if (!buf) {
+        perror("malloc");
+        return 1;
+    }
+
+    // Texto: frecuencias aproximadas del español/inglés, con muchos espacios
+    static const char alphabet[] = "      eeeeaaaooosnrridltcumpbgvyqhfzjx.,\n";
+    srand(1);
+    for (size_t i = 0; i < size; i++) buf[i] = (unsigned char)alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+    failed |= benchBuffer("texto", buf, size);
+
+    // Rachas: bloques largos del mismo byte (relleno, ceros, espacios)
+    for (size_t i = 0; i < size; i++) buf[i] = (unsigned char)((i >> 12) % 3 == 0 ? 'x' : 0);
+    failed |= benchBuffer("rachas", buf, size);
+
+    for (size_t i = 0; i < size; i++) buf[i] = (unsigned char)rand();
+    failed |= benchBuffer("aleatorio", buf, size);
+
+    free(buf);
+    return failed;
+}
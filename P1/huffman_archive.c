@@ -0,0 +1,593 @@
+#include <fnmatch.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman_archive.h"
+
+// ---------------- Longitudes de código ---------------
+static int maxCodeLength(const uint8_t lens[HUFF_SYMBOLS]) {
+    int maxLen = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        if (lens[s] > maxLen) maxLen = lens[s];
+    return maxLen;
+}
+
+int codeLengthsSize(const uint8_t lens[HUFF_SYMBOLS]) {
+    return 1 + (maxCodeLength(lens) <= 15 ? HUFF_SYMBOLS / 2 : HUFF_SYMBOLS);
+}
+
+int encodeCodeLengths(const uint8_t lens[HUFF_SYMBOLS], unsigned char out[1 + HUFF_SYMBOLS]) {
+    uint8_t maxLen = (uint8_t)maxCodeLength(lens);
+    out[0] = maxLen;
+    if (maxLen <= 15) {
+        for (int i = 0; i < HUFF_SYMBOLS / 2; i++)
+            out[1 + i] = (uint8_t)((lens[2 * i] << 4) | lens[2 * i + 1]);
+        return 1 + HUFF_SYMBOLS / 2;
+    }
+    memcpy(out + 1, lens, HUFF_SYMBOLS);
+    return 1 + HUFF_SYMBOLS;
+}
+
+int writeCodeLengths(FILE* out, const uint8_t lens[HUFF_SYMBOLS]) {
+    unsigned char table[1 + HUFF_SYMBOLS];
+    size_t bytes = (size_t)encodeCodeLengths(lens, table);
+    return fwrite(table, 1, bytes, out) == bytes ? 0 : -1;
+}
+
+// ---------------- Lectura sobre memoria --------------
+static const unsigned char* take(struct ArchiveView* view, size_t n) {
+    if (view->size - view->pos < n) return NULL;
+    const unsigned char* p = view->data + view->pos;
+    view->pos += n;
+    return p;
+}
+
+static int takeInt(struct ArchiveView* view, int* value) {
+    const unsigned char* p = take(view, sizeof(int));
+    if (!p) return -1;
+    memcpy(value, p, sizeof(int));
+    return 0;
+}
+
+static int takeInt64(struct ArchiveView* view, int64_t* value) {
+    const unsigned char* p = take(view, sizeof(int64_t));
+    if (!p) return -1;
+    memcpy(value, p, sizeof(int64_t));
+    return 0;
+}
+
+int parseCodeLengths(struct ArchiveView* view, uint8_t lens[HUFF_SYMBOLS]) {
+    const unsigned char* p = take(view, 1);
+    if (!p || *p > HUFF_MAX_CODE_LEN) return -1;
+    uint8_t maxLen = *p;
+
+    if (maxLen <= 15) {
+        const unsigned char* packed = take(view, HUFF_SYMBOLS / 2);
+        if (!packed) return -1;
+        for (int i = 0; i < HUFF_SYMBOLS / 2; i++) {
+            lens[2 * i]     = packed[i] >> 4;
+            lens[2 * i + 1] = packed[i] & 0x0F;
+        }
+    } else {
+        const unsigned char* raw = take(view, HUFF_SYMBOLS);
+        if (!raw) return -1;
+        memcpy(lens, raw, HUFF_SYMBOLS);
+    }
+    return maxCodeLength(lens) == maxLen ? 0 : -1;
+}
+
+// ---------------- Cabecera ----------------------------
+int writeArchiveHeader(FILE* out, int fileCount, int blockSize, const uint8_t lens[HUFF_SYMBOLS]) {
+    uint8_t version = ARCHIVE_VERSION;
+    if (fwrite(ARCHIVE_MAGIC, 1, 4, out) != 4 ||
+        fwrite(&version, 1, 1, out) != 1 ||
+        fwrite(&fileCount, sizeof(int), 1, out) != 1 ||
+        fwrite(&blockSize, sizeof(int), 1, out) != 1)
+        return -1;
+    return writeCodeLengths(out, lens);
+}
+
+int parseArchiveHeader(struct ArchiveView* view, int* fileCount, int* blockSize,
+                       uint8_t lens[HUFF_SYMBOLS]) {
+    const unsigned char* magic = take(view, 4);
+    if (!magic || memcmp(magic, ARCHIVE_MAGIC, 4) != 0) return -1;
+    const unsigned char* version = take(view, 1);
+    if (!version || *version != ARCHIVE_VERSION) return -1;
+    if (takeInt(view, fileCount) != 0 || *fileCount < 0) return -1;
+    if (takeInt(view, blockSize) != 0 || *blockSize < 0) return -1;
+    return parseCodeLengths(view, lens);
+}
+
+// ---------------- Bloques ----------------------------
+int blockCountFor(size_t size, int blockSize) {
+    if (blockSize <= 0) return 1;
+    return (int)((size + (size_t)blockSize - 1) / (size_t)blockSize);
+}
+
+size_t blockEncodedBound(size_t size, int maxLen) {
+    return BLOCK_HEAD_MAX + maxEncodedBytes(size, maxLen);
+}
+
+int chooseBlockTable(const struct BlockCoder* coder, const uint64_t freq[HUFF_SYMBOLS],
+                     struct BlockTable* table) {
+    table->head[0]   = BLOCK_TABLE_GLOBAL;
+    table->headBytes = 1;
+    table->codes     = coder->codes;
+    if (!freq || symbolCount(freq) == 0) return 0;
+
+    // Se comparan bytes, que es lo que ocupa cada opción en el archivo
+    uint8_t lens[HUFF_SYMBOLS];
+    uint64_t optimalBits, limitedBits;
+    if (buildCodeLengths(freq, coder->maxLen, lens, &optimalBits, &limitedBits) < 0) return -1;
+    uint64_t globalBytes = (encodedBitCount(freq, coder->lens) + 7) / 8;
+    uint64_t localBytes  = (encodedBitCount(freq, lens) + 7) / 8 + (uint64_t)codeLengthsSize(lens);
+    if (localBytes >= globalBytes) return 0;
+
+    if (assignCanonicalCodes(lens, table->local) != 0) return -1;
+    table->head[0]   = BLOCK_TABLE_LOCAL;
+    table->headBytes = 1 + encodeCodeLengths(lens, table->head + 1);
+    table->codes     = table->local;
+    return 0;
+}
+
+static int tableForBlock(const struct BlockCoder* coder, const unsigned char* in, size_t size,
+                         struct BlockTable* table) {
+    if (!coder->adaptive) return chooseBlockTable(coder, NULL, table);
+    uint64_t freq[HUFF_SYMBOLS] = {0};
+    countBytes(in, size, freq);
+    return chooseBlockTable(coder, freq, table);
+}
+
+// La cabecera va delante de los bits, ya alineada a byte
+static int encodeWithTable(const struct BlockTable* table, const unsigned char* in, size_t size,
+                           struct BitWriter* bw, struct EncodedBlock* out) {
+    if (bw->capacity < (size_t)table->headBytes) return -1;
+    memcpy(bw->data, table->head, (size_t)table->headBytes);
+    bw->size = (size_t)table->headBytes;
+    if (encodeBytes(table->codes, in, size, bw) != 0) return -1;
+    out->bits = finishBitWriter(bw, NULL) - (uint64_t)table->headBytes * 8;
+    if (bw->failed) return -1;
+    out->data  = bw->data;
+    out->bytes = bw->size;
+    return 0;
+}
+
+int encodeBlock(const struct BlockCoder* coder, const unsigned char* in, size_t size,
+                struct EncodedBlock* out) {
+    struct BlockTable table;
+    struct BitWriter bw;
+    memset(out, 0, sizeof(*out));
+    if (tableForBlock(coder, in, size, &table) != 0) return -1;
+    if (initBitWriter(&bw, size + BLOCK_HEAD_MAX) != 0) return -1;
+    if (encodeWithTable(&table, in, size, &bw, out) != 0) {
+        freeBitWriter(&bw);
+        memset(out, 0, sizeof(*out));
+        return -1;
+    }
+    return 0;
+}
+
+int encodeBlockInto(const struct BlockCoder* coder, const unsigned char* in, size_t size,
+                    unsigned char* buffer, size_t capacity, struct EncodedBlock* out) {
+    struct BlockTable table;
+    struct BitWriter bw;
+    memset(out, 0, sizeof(*out));
+    if (tableForBlock(coder, in, size, &table) != 0) return -1;
+    initBitWriterFixed(&bw, buffer, capacity);
+    return encodeWithTable(&table, in, size, &bw, out);
+}
+
+// ---------------- Índice (TOC) -----------------------
+static int addTocEntry(struct ArchiveToc* toc, const char* name, uint64_t offset,
+                       uint64_t bits, uint64_t originalSize) {
+    if (toc->count == toc->capacity) {
+        int newCap = toc->capacity ? toc->capacity * 2 : 64;
+        struct TocEntry* tmp = realloc(toc->entries, (size_t)newCap * sizeof(struct TocEntry));
+        if (!tmp) return -1;
+        toc->entries  = tmp;
+        toc->capacity = newCap;
+    }
+    struct TocEntry* e = &toc->entries[toc->count];
+    e->name = strdup(name);
+    if (!e->name) return -1;
+    e->offset       = offset;
+    e->bits         = bits;
+    e->originalSize = originalSize;
+    toc->count++;
+    return 0;
+}
+
+void freeArchiveToc(struct ArchiveToc* toc) {
+    for (int i = 0; i < toc->count; i++) free(toc->entries[i].name);
+    free(toc->entries);
+    memset(toc, 0, sizeof(*toc));
+}
+
+int writeArchiveToc(FILE* out, const struct ArchiveToc* toc) {
+    int64_t tocOffset = (int64_t)ftello(out);
+    if (tocOffset < 0) return -1;
+
+    for (int i = 0; i < toc->count; i++) {
+        const struct TocEntry* e = &toc->entries[i];
+        size_t nameLen = strlen(e->name);
+        if (nameLen == 0 || nameLen > HUFF_MAX_NAME) return -1;
+        int64_t fields[3] = { (int64_t)e->offset, (int64_t)e->bits, (int64_t)e->originalSize };
+        int len = (int)nameLen;
+        if (fwrite(&len, sizeof(int), 1, out) != 1 ||
+            fwrite(e->name, 1, nameLen, out) != nameLen ||
+            fwrite(fields, sizeof(int64_t), 3, out) != 3)
+            return -1;
+    }
+
+    if (fwrite(&tocOffset, sizeof(int64_t), 1, out) != 1 ||
+        fwrite(&toc->count, sizeof(int), 1, out) != 1 ||
+        fwrite(TOC_MAGIC, 1, 4, out) != 4)
+        return -1;
+    return 0;
+}
+
+int writeFileRecord(FILE* out, struct ArchiveToc* toc, const char* name, uint64_t originalSize,
+                    int blockSize, const struct EncodedBlock* blocks, int blockCount) {
+    // Un nombre que el lector rechazaría dejaría ilegible todo el archivo
+    int nameLen = (int)strlen(name);
+    if (nameLen == 0 || nameLen > HUFF_MAX_NAME) return -1;
+    off_t offset = ftello(out);
+    if (offset < 0) return -1;
+
+    uint64_t bits = 0;
+    for (int i = 0; i < blockCount; i++) bits += blocks[i].bits;
+    if (toc && addTocEntry(toc, name, (uint64_t)offset, bits, originalSize) != 0) return -1;
+
+    if (fwrite(&nameLen, sizeof(int), 1, out) != 1 ||
+        fwrite(name, 1, (size_t)nameLen, out) != (size_t)nameLen)
+        return -1;
+
+    if (blockSize == 0) {
+        int64_t encodedLen = (int64_t)blocks[0].bits;
+        int lastBitCount   = (encodedLen % 8 == 0) ? 8 : (int)(encodedLen % 8);
+        if (fwrite(&encodedLen, sizeof(int64_t), 1, out) != 1 ||
+            fwrite(blocks[0].data, 1, blocks[0].bytes, out) != blocks[0].bytes ||
+            fwrite(&lastBitCount, sizeof(int), 1, out) != 1)
+            return -1;
+        return 0;
+    }
+
+    if (fwrite(&blockCount, sizeof(int), 1, out) != 1) return -1;
+    for (int i = 0; i < blockCount; i++) {
+        int64_t blockBits = (int64_t)blocks[i].bits;
+        if (fwrite(&blockBits, sizeof(int64_t), 1, out) != 1) return -1;
+    }
+    for (int i = 0; i < blockCount; i++) {
+        if (fwrite(blocks[i].data, 1, blocks[i].bytes, out) != blocks[i].bytes) return -1;
+    }
+    return 0;
+}
+
+// ---------------- Escritura por partes ---------------
+int beginFileRecord(FILE* out, struct RecordWriter* rw, const char* name, uint64_t originalSize,
+                    int blockSize) {
+    memset(rw, 0, sizeof(*rw));
+    int nameLen = (int)strlen(name);
+    if (nameLen == 0 || nameLen > HUFF_MAX_NAME) return -1;
+    rw->out          = out;
+    rw->blockSize    = blockSize;
+    rw->blockCount   = blockCountFor((size_t)originalSize, blockSize);
+    rw->originalSize = originalSize;
+    rw->start        = ftello(out);
+    if (rw->start < 0) return -1;
+
+    if (fwrite(&nameLen, sizeof(int), 1, out) != 1 ||
+        fwrite(name, 1, (size_t)nameLen, out) != (size_t)nameLen)
+        return -1;
+    if (blockSize > 0 && fwrite(&rw->blockCount, sizeof(int), 1, out) != 1) return -1;
+
+    // Huecos para los bits, que se rellenan en closeRecordBlock
+    rw->bitsAt = ftello(out);
+    int64_t zero = 0;
+    for (int i = 0; i < rw->blockCount; i++)
+        if (fwrite(&zero, sizeof(int64_t), 1, out) != 1) return -1;
+    return 0;
+}
+
+int closeRecordBlock(struct RecordWriter* rw, uint64_t bits) {
+    if (rw->block >= rw->blockCount) return -1;
+    off_t end = ftello(rw->out);
+    int64_t value = (int64_t)bits;
+    if (end < 0 ||
+        fseeko(rw->out, rw->bitsAt + (off_t)rw->block * (off_t)sizeof(int64_t), SEEK_SET) != 0 ||
+        fwrite(&value, sizeof(int64_t), 1, rw->out) != 1 ||
+        fseeko(rw->out, end, SEEK_SET) != 0)
+        return -1;
+    rw->block++;
+    rw->totalBits += bits;
+    return 0;
+}
+
+int endFileRecord(struct RecordWriter* rw, struct ArchiveToc* toc, const char* name) {
+    if (rw->block != rw->blockCount) return -1;
+    if (rw->blockSize == 0) {
+        int lastBitCount = (rw->totalBits % 8 == 0) ? 8 : (int)(rw->totalBits % 8);
+        if (fwrite(&lastBitCount, sizeof(int), 1, rw->out) != 1) return -1;
+    }
+    if (toc && addTocEntry(toc, name, (uint64_t)rw->start, rw->totalBits, rw->originalSize) != 0)
+        return -1;
+    return 0;
+}
+
+long long drainBitWriter(FILE* out, struct BitWriter* bw) {
+    if (bw->failed) return -1;
+    size_t n = bw->size;
+    if (n > 0 && fwrite(bw->data, 1, n, out) != n) return -1;
+    bw->size = 0;
+    return (long long)n;
+}
+
+// ---------------- Flujo para tuberías ---------------
+int writePipeHeader(FILE* out) {
+    uint8_t version = PIPE_VERSION;
+    if (fwrite(PIPE_MAGIC, 1, 4, out) != 4 || fwrite(&version, 1, 1, out) != 1) return -1;
+    return 0;
+}
+
+int writePipeEnd(FILE* out) {
+    int64_t zero = 0;
+    return fwrite(&zero, sizeof(int64_t), 1, out) == 1 ? 0 : -1;
+}
+
+int readPipeHeader(FILE* in) {
+    unsigned char head[5];
+    if (fread(head, 1, sizeof(head), in) != sizeof(head)) return -1;
+    if (memcmp(head, PIPE_MAGIC, 4) != 0 || head[4] != PIPE_VERSION) return -1;
+    return 0;
+}
+
+int readPipeFrame(FILE* in, uint8_t lens[HUFF_SYMBOLS], uint64_t* rawBytes, uint64_t* bits,
+                  unsigned char** data, size_t* dataCap) {
+    int64_t raw;
+    if (fread(&raw, sizeof(int64_t), 1, in) != 1) return -1;
+    if (raw == 0) return 0;
+    if (raw < 0 || raw > PIPE_MAX_BLOCK) return -1;
+
+    // La tabla se lee entera y se interpreta con el mismo lector que el archivo
+    unsigned char table[1 + HUFF_SYMBOLS];
+    if (fread(table, 1, 1, in) != 1) return -1;
+    size_t tableBytes = table[0] <= 15 ? HUFF_SYMBOLS / 2 : HUFF_SYMBOLS;
+    if (fread(table + 1, 1, tableBytes, in) != tableBytes) return -1;
+    struct ArchiveView view = { table, 1 + tableBytes, 0 };
+    if (parseCodeLengths(&view, lens) != 0) return -1;
+
+    int64_t b;
+    if (fread(&b, sizeof(int64_t), 1, in) != 1) return -1;
+    if (b < 0 || (uint64_t)b > (uint64_t)raw * HUFF_MAX_CODE_LEN) return -1;
+    size_t bytes = (size_t)(((uint64_t)b + 7) / 8);
+    if (bytes > *dataCap) {
+        unsigned char* grown = realloc(*data, bytes);
+        if (!grown) return -1;
+        *data = grown;
+        *dataCap = bytes;
+    }
+    if (bytes > 0 && fread(*data, 1, bytes, in) != bytes) return -1;
+
+    *rawBytes = (uint64_t)raw;
+    *bits = (uint64_t)b;
+    return 1;
+}
+
+int parsePipeHeader(struct ArchiveView* view) {
+    const unsigned char* head = take(view, 5);
+    if (!head || memcmp(head, PIPE_MAGIC, 4) != 0 || head[4] != PIPE_VERSION) return -1;
+    return 0;
+}
+
+int parsePipeFrame(struct ArchiveView* view, uint8_t lens[HUFF_SYMBOLS], uint64_t* rawBytes,
+                   uint64_t* bits, const unsigned char** data) {
+    int64_t raw, b;
+    if (takeInt64(view, &raw) != 0) return -1;
+    if (raw == 0) return 0;
+    if (raw < 0 || raw > PIPE_MAX_BLOCK) return -1;
+    if (parseCodeLengths(view, lens) != 0) return -1;
+
+    if (takeInt64(view, &b) != 0) return -1;
+    if (b < 0 || (uint64_t)b > (uint64_t)raw * HUFF_MAX_CODE_LEN) return -1;
+    *data = take(view, (size_t)(((uint64_t)b + 7) / 8));
+    if (!*data) return -1;
+
+    *rawBytes = (uint64_t)raw;
+    *bits = (uint64_t)b;
+    return 1;
+}
+
+// ---------------- Lectura de registros ---------------
+static int allocBlockIndex(struct FileRecord* rec, int blockCount) {
+    size_t n = (size_t)(blockCount > 0 ? blockCount : 1);
+    rec->blockCount  = blockCount;
+    rec->blockBits   = calloc(n, sizeof(uint64_t));
+    rec->blockOffset = calloc(n, sizeof(size_t));
+    rec->blockTable  = calloc(n, sizeof(const unsigned char*));
+    return (rec->blockBits && rec->blockOffset && rec->blockTable) ? 0 : -1;
+}
+
+// Cabecera y bits de cada bloque, uno tras otro desde la posición actual
+static int parseRecordBlocks(struct ArchiveView* view, struct FileRecord* rec) {
+    rec->payload = view->data + view->pos;
+    for (int i = 0; i < rec->blockCount; i++) {
+        const unsigned char* head = take(view, 1);
+        if (!head) return -1;
+        if (*head == BLOCK_TABLE_LOCAL) {
+            uint8_t lens[HUFF_SYMBOLS];
+            rec->blockTable[i] = view->data + view->pos;
+            if (parseCodeLengths(view, lens) != 0) return -1;
+        } else if (*head != BLOCK_TABLE_GLOBAL) {
+            return -1;
+        }
+        // Los datos se decodifican en su sitio, sin copiarlos
+        rec->blockOffset[i] = (size_t)(view->data + view->pos - rec->payload);
+        if (!take(view, (size_t)((rec->blockBits[i] + 7) / 8))) return -1;
+    }
+    rec->payloadBytes = (size_t)(view->data + view->pos - rec->payload);
+    return 0;
+}
+
+int parseFileRecord(struct ArchiveView* view, int blockSize, struct FileRecord* rec) {
+    memset(rec, 0, sizeof(*rec));
+
+    int nameLen;
+    if (takeInt(view, &nameLen) != 0 || nameLen <= 0 || nameLen > HUFF_MAX_NAME) return -1;
+    const unsigned char* name = take(view, (size_t)nameLen);
+    rec->name = malloc((size_t)nameLen + 1);
+    if (!name || !rec->name) goto fail;
+    memcpy(rec->name, name, (size_t)nameLen);
+    rec->name[nameLen] = '\0';
+
+    if (blockSize == 0) {
+        int64_t encodedLen;
+        if (takeInt64(view, &encodedLen) != 0 || encodedLen < 0 ||
+            (uint64_t)encodedLen > (uint64_t)view->size * 8) goto fail;
+        if (allocBlockIndex(rec, 1) != 0) goto fail;
+        rec->blockBits[0] = (uint64_t)encodedLen;
+    } else {
+        int blockCount;
+        if (takeInt(view, &blockCount) != 0 || blockCount < 0) goto fail;
+        const unsigned char* bits = take(view, (size_t)blockCount * sizeof(int64_t));
+        if (!bits || allocBlockIndex(rec, blockCount) != 0) goto fail;
+        for (int i = 0; i < blockCount; i++) {
+            int64_t b;
+            memcpy(&b, bits + (size_t)i * sizeof(int64_t), sizeof(int64_t));
+            if (b < 0 || (uint64_t)b > (uint64_t)view->size * 8) goto fail;
+            rec->blockBits[i] = (uint64_t)b;
+        }
+    }
+    if (parseRecordBlocks(view, rec) != 0) goto fail;
+
+    if (blockSize == 0) {
+        int lastBitCount;
+        if (takeInt(view, &lastBitCount) != 0) goto fail;
+    }
+    return 0;
+
+fail:
+    freeFileRecord(rec);
+    return -1;
+}
+
+int parseFileRecordAt(struct ArchiveView* view, uint64_t offset, int blockSize, struct FileRecord* rec) {
+    memset(rec, 0, sizeof(*rec));
+    if (offset > view->size) return -1;
+    view->pos = (size_t)offset;
+    return parseFileRecord(view, blockSize, rec);
+}
+
+int parseArchiveToc(const struct ArchiveView* view, struct ArchiveToc* toc) {
+    memset(toc, 0, sizeof(*toc));
+
+    const size_t footerSize = sizeof(int64_t) + sizeof(int) + 4;
+    if (view->size < footerSize) return -1;
+    const unsigned char* footer = view->data + view->size - footerSize;
+    if (memcmp(footer + sizeof(int64_t) + sizeof(int), TOC_MAGIC, 4) != 0) return -1;
+
+    int64_t tocOffset;
+    int tocCount;
+    memcpy(&tocOffset, footer, sizeof(int64_t));
+    memcpy(&tocCount, footer + sizeof(int64_t), sizeof(int));
+    if (tocOffset < 0 || (uint64_t)tocOffset > view->size - footerSize || tocCount < 0) return -1;
+
+    // El índice ocupa exactamente el tramo entre tocOffset y el pie
+    struct ArchiveView cursor = { view->data, view->size - footerSize, (size_t)tocOffset };
+    for (int i = 0; i < tocCount; i++) {
+        int nameLen;
+        const unsigned char* name;
+        const unsigned char* fields;
+        if (takeInt(&cursor, &nameLen) != 0 || nameLen <= 0 || nameLen > HUFF_MAX_NAME ||
+            !(name = take(&cursor, (size_t)nameLen)) ||
+            !(fields = take(&cursor, 3 * sizeof(int64_t))))
+            goto fail;
+
+        char* copy = malloc((size_t)nameLen + 1);
+        if (!copy) goto fail;
+        memcpy(copy, name, (size_t)nameLen);
+        copy[nameLen] = '\0';
+
+        int64_t v[3];
+        memcpy(v, fields, sizeof(v));
+        int rc = (v[0] >= 0 && v[0] < tocOffset && v[1] >= 0 && v[2] >= 0)
+                     ? addTocEntry(toc, copy, (uint64_t)v[0], (uint64_t)v[1], (uint64_t)v[2]) : -1;
+        free(copy);
+        if (rc != 0) goto fail;
+    }
+    if (cursor.pos != cursor.size) goto fail;
+    return 0;
+
+fail:
+    freeArchiveToc(toc);
+    return -1;
+}
+
+int tocNameSelected(const char* name, char* const patterns[], int patternCount) {
+    if (patternCount == 0) return 1;
+    for (int i = 0; i < patternCount; i++)
+        if (fnmatch(patterns[i], name, 0) == 0) return 1;
+    return 0;
+}
+
+void freeFileRecord(struct FileRecord* rec) {
+    free(rec->name);
+    free(rec->blockBits);
+    free(rec->blockOffset);
+    free(rec->blockTable);
+    memset(rec, 0, sizeof(*rec));
+}
+
+// Longitudes de la tabla propia del bloque i, ya validada al leer el registro
+static int recordBlockLens(const struct FileRecord* rec, int i, uint8_t lens[HUFF_SYMBOLS]) {
+    struct ArchiveView view = { rec->blockTable[i], 1 + HUFF_SYMBOLS, 0 };
+    return parseCodeLengths(&view, lens);
+}
+
+size_t recordOutputCapacity(const struct DecodeTable* table, const struct FileRecord* rec,
+                            int blockSize) {
+    if (blockSize > 0) return (size_t)rec->blockCount * (size_t)blockSize;
+    if (!rec->blockTable[0]) return decodedCapacity(table, rec->blockBits[0]);
+
+    uint8_t lens[HUFF_SYMBOLS];
+    int minLen = HUFF_MAX_CODE_LEN;
+    if (recordBlockLens(rec, 0, lens) != 0) return 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        if (lens[s] > 0 && lens[s] < minLen) minLen = lens[s];
+    return (size_t)(rec->blockBits[0] / (uint64_t)minLen);
+}
+
+const struct DecodeTable* recordBlockTable(const struct DecodeTable* table, struct DecodeTable* scratch,
+                                           const struct FileRecord* rec, int i) {
+    if (!rec->blockTable[i]) return table;
+    uint8_t lens[HUFF_SYMBOLS];
+    struct HuffCode codes[HUFF_SYMBOLS];
+    if (recordBlockLens(rec, i, lens) != 0 || assignCanonicalCodes(lens, codes) != 0 ||
+        rebuildDecodeTable(scratch, codes) != 0)
+        return NULL;
+    return scratch;
+}
+
+long long decodeRecordBlock(const struct DecodeTable* table, struct DecodeTable* scratch,
+                            const struct FileRecord* rec, int i, unsigned char* out, size_t cap) {
+    const struct DecodeTable* use = recordBlockTable(table, scratch, rec, i);
+    if (!use) return -1;
+    size_t bytes = (size_t)((rec->blockBits[i] + 7) / 8);
+    return decodeBits(use, rec->payload + rec->blockOffset[i], bytes, rec->blockBits[i], out, cap);
+}
+
+long long decodeRecordRange(const struct DecodeTable* table, struct DecodeTable* scratch,
+                            const struct FileRecord* rec, int blockSize, int first, int last,
+                            unsigned char* out, size_t cap) {
+    long long total = 0;
+    for (int i = first; i < last; i++) {
+        size_t room = cap - (size_t)total;
+        if (blockSize > 0 && room > (size_t)blockSize) room = (size_t)blockSize;
+        long long n = decodeRecordBlock(table, scratch, rec, i, out + total, room);
+        if (n < 0) return -1;
+        if (blockSize > 0 && i < rec->blockCount - 1 && n != blockSize) return -1;
+        total += n;
+    }
+    return total;
+}
@@ -0,0 +1,236 @@
+#ifndef HUFFMAN_ARCHIVE_H
+#define HUFFMAN_ARCHIVE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "huffman_codec.h"
+
+// Cabecera del archivo .bin:
+//   char    magic[4]     "HUFC"
+//   uint8_t version
+//   int     fileCount
+//   int     blockSize    bytes de entrada por bloque (0 = un flujo por archivo)
+//   tabla de longitudes de código (ver writeCodeLengths)
+// seguida de un registro por archivo. Con blockSize == 0:
+//   int nameLen, char name[nameLen], int64 encodedLen (bits),
+//   bytes[(encodedLen + 7) / 8], int lastBitCount
+// Con blockSize > 0 cada archivo se parte en bloques de blockSize bytes que
+// se codifican por separado y empiezan alineados a byte:
+//   int nameLen, char name[nameLen], int blockCount,
+//   int64 blockBits[blockCount], bytes de todos los bloques
+// Los bytes de cada bloque (o del flujo continuo) empiezan con su cabecera:
+//   uint8_t tabla    BLOCK_TABLE_GLOBAL o BLOCK_TABLE_LOCAL
+//   si es propia, su tabla de longitudes (ver writeCodeLengths)
+// y siguen sus bits. blockBits y encodedLen cuentan solo los bits de datos.
+// Los bits y tamaños van en 64 bits: un archivo de más de 256 MB ya no cabe
+// en un int contado en bits.
+// Tras el último registro va el índice (TOC), una entrada por archivo:
+//   int nameLen, char name[nameLen], int64 offset del registro,
+//   int64 bits comprimidos, int64 tamaño original
+// y el pie, que permite encontrar el índice desde el final:
+//   int64 tocOffset, int tocCount, char magic[4] "HTOC"
+#define ARCHIVE_MAGIC   "HUFC"
+#define ARCHIVE_VERSION 5
+#define TOC_MAGIC       "HTOC"
+
+#define ARCHIVE_DEFAULT_BLOCK_KB 256
+
+// Longitud máxima de un nombre (ruta relativa) dentro del archivo. La ruta de
+// salida, directorio + '/' + nombre, se compone en ARCHIVE_PATH_MAX bytes.
+#define HUFF_MAX_NAME    3072
+#define ARCHIVE_PATH_MAX 4096
+
+// Flujo para tuberías (stdin -> stdout), sin índice ni tabla global:
+//   char magic[4] "HUFP", uint8_t version
+// y después una trama por bloque, cada una con su propia tabla:
+//   int64 rawBytes, tabla de longitudes, int64 bits, bytes[(bits + 7) / 8]
+// Una trama con rawBytes == 0 marca el final del flujo.
+#define PIPE_MAGIC     "HUFP"
+#define PIPE_VERSION   1
+#define PIPE_MAX_BLOCK (1024 * 1024 * 1024) // bytes sin comprimir por trama
+
+// Longitudes de los 256 símbolos: un byte con la longitud máxima y después
+// 128 bytes con dos longitudes de 4 bits cada uno si todas caben en 15 bits,
+// o 256 bytes en otro caso.
+int writeCodeLengths(FILE* out, const uint8_t lens[HUFF_SYMBOLS]);
+// Igual que writeCodeLengths pero en memoria. Devuelve los bytes escritos.
+int encodeCodeLengths(const uint8_t lens[HUFF_SYMBOLS], unsigned char out[1 + HUFF_SYMBOLS]);
+// Bytes que ocupa la tabla de longitudes en el archivo.
+int codeLengthsSize(const uint8_t lens[HUFF_SYMBOLS]);
+
+int writeArchiveHeader(FILE* out, int fileCount, int blockSize, const uint8_t lens[HUFF_SYMBOLS]);
+
+// ---------------- Lectura sobre memoria --------------
+// Los lectores recorren el archivo ya proyectado en memoria: 'pos' avanza
+// sobre 'data' a medida que se interpretan los campos.
+struct ArchiveView {
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+};
+
+int parseCodeLengths(struct ArchiveView* view, uint8_t lens[HUFF_SYMBOLS]);
+// Devuelve 0 si la cabecera es válida, -1 si no es un archivo de esta versión
+// o está truncada.
+int parseArchiveHeader(struct ArchiveView* view, int* fileCount, int* blockSize,
+                       uint8_t lens[HUFF_SYMBOLS]);
+
+// ---------------- Bloques ----------------------------
+#define BLOCK_TABLE_GLOBAL 0
+#define BLOCK_TABLE_LOCAL  1
+#define BLOCK_HEAD_MAX     (1 + 1 + HUFF_SYMBOLS) // selector y tabla propia
+
+struct EncodedBlock {
+    unsigned char* data;   // cabecera del bloque y sus bits
+    size_t         bytes;
+    uint64_t       bits;   // solo los de datos
+};
+
+// Tabla global del archivo y cómo la usan los bloques.
+struct BlockCoder {
+    const uint8_t*         lens;
+    const struct HuffCode* codes;
+    int maxLen;     // límite de -L para las tablas propias (0 = ninguno)
+    int adaptive;   // -a: cada bloque elige entre la global y una propia
+};
+
+// Tabla elegida para un bloque y la cabecera que la describe.
+struct BlockTable {
+    unsigned char          head[BLOCK_HEAD_MAX];
+    int                    headBytes;
+    const struct HuffCode* codes;      // la global o 'local'
+    struct HuffCode        local[HUFF_SYMBOLS];
+};
+
+// Número de bloques en que se parte un archivo de 'size' bytes.
+int blockCountFor(size_t size, int blockSize);
+// Cota de bytes de un bloque de 'size' bytes si la tabla global llega a
+// 'maxLen' bits: una tabla propia solo se elige si ocupa menos.
+size_t blockEncodedBound(size_t size, int maxLen);
+// Elige la tabla de un bloque con histograma 'freq' (NULL = siempre la
+// global): la propia solo si sus datos más su tabla ocupan menos bytes que
+// los datos con la global. Devuelve -1 si no se pudo construir.
+int chooseBlockTable(const struct BlockCoder* coder, const uint64_t freq[HUFF_SYMBOLS],
+                     struct BlockTable* table);
+// Codifica un bloque en un buffer propio (el llamador libera 'out->data').
+// Con coder->adaptive cuenta antes sus bytes para elegir la tabla.
+int encodeBlock(const struct BlockCoder* coder, const unsigned char* in, size_t size,
+                struct EncodedBlock* out);
+// Igual que encodeBlock pero escribe en 'buffer' (capacidad según
+// blockEncodedBound); 'out->data' apunta dentro de 'buffer' y no se libera.
+int encodeBlockInto(const struct BlockCoder* coder, const unsigned char* in, size_t size,
+                    unsigned char* buffer, size_t capacity, struct EncodedBlock* out);
+
+// ---------------- Índice (TOC) -----------------------
+struct TocEntry {
+    char*    name;
+    uint64_t offset;        // inicio del registro dentro del archivo
+    uint64_t bits;          // bits comprimidos de todos sus bloques
+    uint64_t originalSize;  // bytes del archivo sin comprimir
+};
+
+struct ArchiveToc {
+    struct TocEntry* entries;
+    int count;
+    int capacity;
+};
+
+void freeArchiveToc(struct ArchiveToc* toc);
+// Escribe el índice y el pie al final del archivo.
+int  writeArchiveToc(FILE* out, const struct ArchiveToc* toc);
+
+// Escribe el registro de un archivo y lo anota en 'toc'. Con blockSize == 0
+// se espera un único bloque y se usa el formato de flujo continuo.
+int writeFileRecord(FILE* out, struct ArchiveToc* toc, const char* name, uint64_t originalSize,
+                    int blockSize, const struct EncodedBlock* blocks, int blockCount);
+
+// ---------------- Escritura por partes ---------------
+// Para comprimir sin tener el archivo entero en memoria: el registro se
+// escribe a medida que se codifica y los bits de cada bloque, que solo se
+// conocen al final del bloque, se rellenan después en su hueco.
+struct RecordWriter {
+    FILE*    out;
+    off_t    start;         // inicio del registro (para el índice)
+    off_t    bitsAt;        // hueco de encodedLen o de blockBits[0]
+    int      blockSize;
+    int      blockCount;
+    int      block;         // siguiente bloque por cerrar
+    uint64_t totalBits;
+    uint64_t originalSize;
+};
+
+int beginFileRecord(FILE* out, struct RecordWriter* rw, const char* name, uint64_t originalSize,
+                    int blockSize);
+// Cierra el bloque en curso, cuyos bytes ya se escribieron, con 'bits' bits útiles.
+int closeRecordBlock(struct RecordWriter* rw, uint64_t bits);
+// Termina el registro y lo anota en 'toc'. Falla si no se cerraron todos los bloques.
+int endFileRecord(struct RecordWriter* rw, struct ArchiveToc* toc, const char* name);
+// Escribe los bytes ya volcados en 'bw' y lo vacía; los bits pendientes del
+// acumulador se conservan. Devuelve los bytes escritos o -1.
+long long drainBitWriter(FILE* out, struct BitWriter* bw);
+
+// ---------------- Flujo para tuberías ---------------
+int writePipeHeader(FILE* out);
+int writePipeEnd(FILE* out);
+int readPipeHeader(FILE* in);
+// Lee la trama siguiente; '*data' crece según haga falta (el llamador la
+// libera). Devuelve 1 si leyó una trama, 0 al llegar al final y -1 si el
+// flujo está truncado o es inválido.
+int readPipeFrame(FILE* in, uint8_t lens[HUFF_SYMBOLS], uint64_t* rawBytes, uint64_t* bits,
+                  unsigned char** data, size_t* dataCap);
+// Versiones sobre memoria (las tramas las escribe huffman_lib). 'data'
+// apunta dentro de la vista; parsePipeFrame devuelve 1, 0 o -1 como readPipeFrame.
+int parsePipeHeader(struct ArchiveView* view);
+int parsePipeFrame(struct ArchiveView* view, uint8_t lens[HUFF_SYMBOLS], uint64_t* rawBytes,
+                   uint64_t* bits, const unsigned char** data);
+
+// ---------------- Lectura de registros ---------------
+// Un registro leído se ve siempre como una lista de bloques: en el formato de
+// flujo continuo hay un solo bloque con todo el archivo.
+struct FileRecord {
+    char*                name;
+    const unsigned char* payload;      // bytes de todos los bloques, dentro de la vista
+    size_t               payloadBytes;
+    int                  blockCount;
+    uint64_t*            blockBits;    // bits útiles de cada bloque
+    size_t*              blockOffset;  // inicio de los bits de cada bloque dentro de 'payload'
+    const unsigned char** blockTable;  // tabla propia de cada bloque (NULL = la global)
+};
+
+// Lee el registro siguiente de la vista. 'payload' apunta a la vista, que
+// debe seguir proyectada mientras se use el registro. Devuelve 0 si leyó el
+// registro completo, -1 si está truncado o es inválido.
+int  parseFileRecord(struct ArchiveView* view, int blockSize, struct FileRecord* rec);
+// Lee el registro que empieza en 'offset' (tomado del índice).
+int  parseFileRecordAt(struct ArchiveView* view, uint64_t offset, int blockSize, struct FileRecord* rec);
+void freeFileRecord(struct FileRecord* rec);
+
+// Lee el índice a partir del pie del archivo completo. Devuelve -1 si falta
+// o no es coherente con el tamaño del archivo.
+int parseArchiveToc(const struct ArchiveView* view, struct ArchiveToc* toc);
+// 1 si 'name' coincide con algún patrón glob de 'patterns' (o si no hay patrones).
+int tocNameSelected(const char* name, char* const patterns[], int patternCount);
+
+// Bytes de salida a reservar para el archivo completo: blockCount * blockSize
+// con bloques, o la cota de decodedCapacity para un flujo continuo.
+size_t recordOutputCapacity(const struct DecodeTable* table, const struct FileRecord* rec,
+                            int blockSize);
+// Tabla con la que se decodifica el bloque i: 'table' (la global) o, si el
+// bloque trae la suya, 'scratch' reconstruida con ella. NULL si no es válida.
+const struct DecodeTable* recordBlockTable(const struct DecodeTable* table, struct DecodeTable* scratch,
+                                           const struct FileRecord* rec, int i);
+// Decodifica el bloque i en 'out'. 'scratch' es una tabla del llamador (a
+// cero la primera vez) para los bloques con tabla propia. Devuelve los bytes
+// obtenidos o -1.
+long long decodeRecordBlock(const struct DecodeTable* table, struct DecodeTable* scratch,
+                            const struct FileRecord* rec, int i, unsigned char* out, size_t cap);
+// Decodifica los bloques [first, last) a partir de 'out', que apunta al byte
+// first * blockSize del archivo. Todo bloque salvo el último del archivo debe
+// producir exactamente blockSize bytes. Devuelve los bytes escritos o -1.
+long long decodeRecordRange(const struct DecodeTable* table, struct DecodeTable* scratch,
+                            const struct FileRecord* rec, int blockSize, int first, int last,
+                            unsigned char* out, size_t cap);
+
+#endif
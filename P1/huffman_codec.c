@@ -0,0 +1,575 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman_codec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HUFF_HAVE_AVX2_KERNEL 1
+#endif
+
+// ---------------- Histograma -------------------------
+// Los subhistogramas son de 32 bits para que quepan en L1 (4 KB); se vuelcan
+// a 'freq' cada HIST_CHUNK bytes, antes de que puedan desbordarse.
+#define HIST_CHUNK ((size_t)1 << 30)
+
+#define COUNT_WORD(w)                                                         \
+    do {                                                                      \
+        t0[(w) & 0xff]++;         t1[((w) >> 8) & 0xff]++;                    \
+        t2[((w) >> 16) & 0xff]++; t3[((w) >> 24) & 0xff]++;                   \
+        t0[((w) >> 32) & 0xff]++; t1[((w) >> 40) & 0xff]++;                   \
+        t2[((w) >> 48) & 0xff]++; t3[(w) >> 56]++;                            \
+    } while (0)
+
+static void mergeSubHistograms(uint32_t t[4][HUFF_SYMBOLS], uint64_t freq[HUFF_SYMBOLS]) {
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        freq[s] += (uint64_t)t[0][s] + t[1][s] + t[2][s] + t[3][s];
+}
+
+// Reparte in[0..n) en los subhistogramas, 16 bytes por vuelta
+static void countRange(const unsigned char* in, size_t n, uint32_t t[4][HUFF_SYMBOLS]) {
+    uint32_t *t0 = t[0], *t1 = t[1], *t2 = t[2], *t3 = t[3];
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint64_t a, b;
+        memcpy(&a, in + i, 8);
+        memcpy(&b, in + i + 8, 8);
+        COUNT_WORD(a);
+        COUNT_WORD(b);
+    }
+    for (; i < n; i++) t0[in[i]]++;
+}
+
+void countBytesScalar(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]) {
+    uint32_t t[4][HUFF_SYMBOLS];
+    while (size > 0) {
+        size_t n = size < HIST_CHUNK ? size : HIST_CHUNK;
+        memset(t, 0, sizeof(t));
+        countRange(in, n, t);
+        mergeSubHistograms(t, freq);
+        in += n;
+        size -= n;
+    }
+}
+
+#ifdef HUFF_HAVE_AVX2_KERNEL
+// Rachas: antes de repartir cada tramo de 32 bytes se comprueba con una
+// comparación vectorial si son todos el mismo byte (espacios, ceros, ...) y
+// en ese caso se suman 32 de una vez. En texto normal la comprobación no
+// acierta nunca y solo cuesta, así que cada segmento se sondea primero y va
+// por el camino portable si en su comienzo no hay ninguna racha.
+#define RUN_SEGMENT ((size_t)64 * 1024)
+#define RUN_PROBE   ((size_t)1024)
+
+__attribute__((target("avx2")))
+static int isUniform32(const unsigned char* p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i first = _mm256_set1_epi8((char)p[0]);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, first)) == -1;
+}
+
+__attribute__((target("avx2")))
+static void countRuns(const unsigned char* in, size_t n, uint32_t t[4][HUFF_SYMBOLS]) {
+    uint32_t *t0 = t[0], *t1 = t[1], *t2 = t[2], *t3 = t[3];
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        if (isUniform32(in + i)) {
+            t0[in[i]] += 32;
+            continue;
+        }
+        uint64_t a, b, c, d;
+        memcpy(&a, in + i, 8);
+        memcpy(&b, in + i + 8, 8);
+        memcpy(&c, in + i + 16, 8);
+        memcpy(&d, in + i + 24, 8);
+        COUNT_WORD(a);
+        COUNT_WORD(b);
+        COUNT_WORD(c);
+        COUNT_WORD(d);
+    }
+    for (; i < n; i++) t0[in[i]]++;
+}
+
+__attribute__((target("avx2")))
+static void countBytesAvx2(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]) {
+    uint32_t t[4][HUFF_SYMBOLS];
+    while (size > 0) {
+        size_t n = size < HIST_CHUNK ? size : HIST_CHUNK;
+        memset(t, 0, sizeof(t));
+        for (size_t off = 0; off < n; off += RUN_SEGMENT) {
+            size_t seg = n - off < RUN_SEGMENT ? n - off : RUN_SEGMENT;
+            int runs = 0;
+            for (size_t i = 0; i + 32 <= seg && i < RUN_PROBE && !runs; i += 32)
+                runs = isUniform32(in + off + i);
+            if (runs) countRuns(in + off, seg, t);
+            else countRange(in + off, seg, t);
+        }
+        mergeSubHistograms(t, freq);
+        in += n;
+        size -= n;
+    }
+}
+#endif
+
+void countBytes(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]) {
+#ifdef HUFF_HAVE_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) {
+        countBytesAvx2(in, size, freq);
+        return;
+    }
+#endif
+    countBytesScalar(in, size, freq);
+}
+
+// ---------------- Códigos canónicos ------------------
+int assignCanonicalCodes(const uint8_t lens[HUFF_SYMBOLS], struct HuffCode codes[HUFF_SYMBOLS]) {
+    uint64_t count[HUFF_MAX_CODE_LEN + 1] = {0};
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        if (lens[s] > HUFF_MAX_CODE_LEN) return -1;
+        if (lens[s] > 0) count[lens[s]]++;
+    }
+
+    // Desigualdad de Kraft: no puede haber más códigos que hojas disponibles
+    uint64_t left = 1;
+    for (int len = 1; len <= HUFF_MAX_CODE_LEN; len++) {
+        left <<= 1;
+        if (count[len] > left) return -1;
+        left -= count[len];
+        if (left > HUFF_SYMBOLS) left = HUFF_SYMBOLS + 1; // ya sobra espacio
+    }
+
+    // Primer código de cada longitud
+    uint64_t next[HUFF_MAX_CODE_LEN + 1];
+    uint64_t code = 0;
+    next[0] = 0;
+    for (int len = 1; len <= HUFF_MAX_CODE_LEN; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        codes[s].len  = lens[s];
+        codes[s].bits = lens[s] ? next[lens[s]]++ : 0;
+    }
+    return 0;
+}
+
+// ---------------- Longitudes limitadas ---------------
+// Un nivel de package-merge tiene como mucho 2n - 1 elementos: n hojas y
+// n - 1 paquetes.
+#define PM_MAX_ITEMS (2 * HUFF_SYMBOLS)
+
+struct PMItem {
+    uint64_t weight;
+    int      symbol;
+};
+
+static int compareLeaves(const void* a, const void* b) {
+    const struct PMItem* x = a;
+    const struct PMItem* y = b;
+    if (x->weight != y->weight) return x->weight < y->weight ? -1 : 1;
+    return x->symbol - y->symbol;
+}
+
+int limitCodeLengths(const uint64_t freq[HUFF_SYMBOLS], int maxLen, uint8_t lens[HUFF_SYMBOLS]) {
+    struct PMItem leaves[HUFF_SYMBOLS];
+    int n = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        lens[s] = 0;
+        if (freq[s] > 0) {
+            leaves[n].weight = freq[s];
+            leaves[n].symbol = s;
+            n++;
+        }
+    }
+    if (n == 0) return 0;
+    if (n == 1) { lens[leaves[0].symbol] = 1; return 0; }
+    if (maxLen < 1 || maxLen > HUFF_MAX_CODE_LEN || (n > (1 << (maxLen < 9 ? maxLen : 9))))
+        return -1;
+
+    qsort(leaves, (size_t)n, sizeof(struct PMItem), compareLeaves);
+
+    // El nivel 0 es el más profundo (solo hojas); cada nivel siguiente mezcla
+    // las hojas con los paquetes de pares consecutivos del anterior. Para
+    // formar un nivel basta con los pesos del anterior, así que se alternan
+    // dos filas. De cada nivel solo se recuerda qué posiciones son paquetes:
+    // las hojas aparecen en orden, de modo que si las k primeras posiciones
+    // tienen m paquetes, las hojas entre ellas son leaves[0, k - m).
+    uint64_t weights[2][PM_MAX_ITEMS];
+    uint64_t isPackage[HUFF_MAX_CODE_LEN][PM_MAX_ITEMS / 64];
+    int sizes[HUFF_MAX_CODE_LEN];
+    memset(isPackage, 0, (size_t)maxLen * sizeof(isPackage[0]));
+
+    for (int i = 0; i < n; i++) weights[0][i] = leaves[i].weight;
+    sizes[0] = n;
+    for (int level = 1; level < maxLen; level++) {
+        const uint64_t* prev = weights[(level - 1) & 1];
+        uint64_t* cur = weights[level & 1];
+        int packages = sizes[level - 1] / 2;
+        int li = 0, pi = 0, k = 0;
+        while (li < n || pi < packages) {
+            uint64_t pw = pi < packages ? prev[2 * pi] + prev[2 * pi + 1] : 0;
+            if (pi >= packages || (li < n && leaves[li].weight <= pw)) {
+                cur[k++] = leaves[li++].weight;
+            } else {
+                isPackage[level][k / 64] |= 1ULL << (k % 64);
+                cur[k++] = pw;
+                pi++;
+            }
+        }
+        sizes[level] = k;
+    }
+
+    // Se eligen los 2n-2 primeros elementos del nivel superior; cada paquete
+    // elegido arrastra a sus dos componentes del nivel inferior. La longitud
+    // de un símbolo es el número de veces que aparece elegido.
+    int take = 2 * n - 2;
+    for (int level = maxLen - 1; level >= 0 && take > 0; level--) {
+        int count = take < sizes[level] ? take : sizes[level];
+        int packages = 0;
+        for (int w = 0; w < count / 64; w++) packages += __builtin_popcountll(isPackage[level][w]);
+        if (count % 64)
+            packages += __builtin_popcountll(isPackage[level][count / 64] & ((1ULL << (count % 64)) - 1));
+        for (int k = 0; k < count - packages; k++) lens[leaves[k].symbol]++;
+        take = 2 * packages;
+    }
+    return 0;
+}
+
+int symbolCount(const uint64_t freq[HUFF_SYMBOLS]) {
+    int n = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        if (freq[s] > 0) n++;
+    return n;
+}
+
+uint64_t encodedBitCount(const uint64_t freq[HUFF_SYMBOLS], const uint8_t lens[HUFF_SYMBOLS]) {
+    uint64_t bits = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        bits += freq[s] * lens[s];
+    return bits;
+}
+
+// Longitudes óptimas sin límite (Huffman con dos colas): las hojas ordenadas
+// por peso forman una cola y los nodos internos, que se crean en orden no
+// decreciente de peso, la otra. No reserva memoria: n <= 256.
+static void huffmanLengths(const uint64_t freq[HUFF_SYMBOLS], uint8_t lens[HUFF_SYMBOLS]) {
+    struct PMItem leaves[HUFF_SYMBOLS];
+    int n = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        lens[s] = 0;
+        if (freq[s] > 0) {
+            leaves[n].weight = freq[s];
+            leaves[n].symbol = s;
+            n++;
+        }
+    }
+    if (n == 0) return;
+    if (n == 1) { lens[leaves[0].symbol] = 1; return; }
+    qsort(leaves, (size_t)n, sizeof(struct PMItem), compareLeaves);
+
+    uint64_t nodeWeight[HUFF_SYMBOLS];
+    int leafParent[HUFF_SYMBOLS], nodeParent[HUFF_SYMBOLS];
+    int li = 0, ni = 0;
+    for (int k = 0; k < n - 1; k++) {
+        uint64_t w = 0;
+        for (int pick = 0; pick < 2; pick++) {
+            // A igual peso gana la hoja: el árbol queda menos profundo
+            if (li < n && (ni >= k || leaves[li].weight <= nodeWeight[ni])) {
+                w += leaves[li].weight;
+                leafParent[li++] = k;
+            } else {
+                w += nodeWeight[ni];
+                nodeParent[ni++] = k;
+            }
+        }
+        nodeWeight[k] = w;
+    }
+
+    // La raíz es el último nodo; la profundidad baja de padres a hijos
+    uint8_t depth[HUFF_SYMBOLS];
+    depth[n - 2] = 0;
+    for (int k = n - 3; k >= 0; k--) depth[k] = (uint8_t)(depth[nodeParent[k]] + 1);
+    for (int i = 0; i < n; i++) lens[leaves[i].symbol] = (uint8_t)(depth[leafParent[i]] + 1);
+}
+
+int buildCodeLengths(const uint64_t freq[HUFF_SYMBOLS], int limit, uint8_t lens[HUFF_SYMBOLS],
+                     uint64_t* optimalBits, uint64_t* limitedBits) {
+    if (limit <= 0 || limit > HUFF_MAX_CODE_LEN) limit = HUFF_MAX_CODE_LEN;
+    huffmanLengths(freq, lens);
+
+    int maxLen = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
+        if (lens[s] > maxLen) maxLen = lens[s];
+    if (maxLen <= limit) return 0;
+
+    *optimalBits = encodedBitCount(freq, lens);
+    if (limitCodeLengths(freq, limit, lens) != 0) return -1;
+    *limitedBits = encodedBitCount(freq, lens);
+    return 1;
+}
+
+// ---------------- Escritor de bits -------------------
+int initBitWriter(struct BitWriter* bw, size_t capacityHint) {
+    memset(bw, 0, sizeof(*bw));
+    bw->capacity = capacityHint > 64 ? capacityHint : 64;
+    bw->data = malloc(bw->capacity);
+    if (!bw->data) {
+        perror("malloc");
+        bw->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+void initBitWriterFixed(struct BitWriter* bw, unsigned char* buffer, size_t capacity) {
+    memset(bw, 0, sizeof(*bw));
+    bw->data = buffer;
+    bw->capacity = capacity;
+    bw->fixed = 1;
+}
+
+size_t maxEncodedBytes(size_t symbols, int maxLen) {
+    // palabras completas de 64 bits más el último volcado parcial
+    return ((symbols * (size_t)maxLen + 63) / 64) * 8 + 8;
+}
+
+static int growBitWriter(struct BitWriter* bw, size_t need) {
+    if (bw->failed) return -1;
+    if (bw->size + need <= bw->capacity) return 0;
+    if (bw->fixed) {
+        bw->failed = 1;
+        return -1;
+    }
+    size_t newCap = bw->capacity * 2;
+    while (newCap < bw->size + need) newCap *= 2;
+    unsigned char* tmp = realloc(bw->data, newCap);
+    if (!tmp) {
+        perror("realloc");
+        bw->failed = 1;
+        return -1;
+    }
+    bw->data = tmp;
+    bw->capacity = newCap;
+    return 0;
+}
+
+void flushBitWriterWord(struct BitWriter* bw, uint64_t word) {
+    if (growBitWriter(bw, 8) != 0) return;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    memcpy(bw->data + bw->size, &word, sizeof(word));
+    bw->size += 8;
+}
+
+uint64_t finishBitWriter(struct BitWriter* bw, int* lastBitCount) {
+    uint64_t totalBits = (uint64_t)bw->size * 8 + (uint64_t)bw->cnt;
+    int tailBytes = (bw->cnt + 7) / 8;
+    if (tailBytes > 0 && growBitWriter(bw, (size_t)tailBytes) == 0) {
+        for (int i = 0; i < tailBytes; i++)
+            bw->data[bw->size++] = (unsigned char)(bw->acc >> (56 - 8 * i));
+    }
+    if (lastBitCount) *lastBitCount = (bw->cnt % 8 == 0) ? 8 : bw->cnt % 8;
+    bw->acc = 0;
+    bw->cnt = 0;
+    return totalBits;
+}
+
+void freeBitWriter(struct BitWriter* bw) {
+    if (!bw->fixed) free(bw->data);
+    memset(bw, 0, sizeof(*bw));
+}
+
+int encodeBytes(const struct HuffCode codes[HUFF_SYMBOLS], const unsigned char* in, size_t size,
+                struct BitWriter* bw) {
+    for (size_t i = 0; i < size; i++) {
+        const struct HuffCode* c = &codes[in[i]];
+        if (c->len == 0) return -1;
+        putBits(bw, c->bits, c->len);
+    }
+    return bw->failed ? -1 : 0;
+}
+
+// ---------------- Lector de bits ---------------------
+// Acumulador de 64 bits alineado a la izquierda: el siguiente bit del flujo es
+// el más significativo de 'buf'. 'cnt' cuenta los bits válidos cargados.
+struct BitReader {
+    const unsigned char* in;
+    size_t   pos;
+    size_t   size;
+    uint64_t buf;
+    int      cnt;
+};
+
+static inline uint64_t loadBigEndian64(const unsigned char* p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+// Deja al menos 57 bits válidos en el acumulador (o todos los que queden).
+static inline void refillBits(struct BitReader* br) {
+    if (br->cnt >= 57) return;
+    if (br->pos + 8 <= br->size) {
+        // Carga de palabra completa: los bits que sobrepasan 'cnt' son los
+        // correctos del flujo y se vuelven a cargar en la siguiente recarga.
+        br->buf |= loadBigEndian64(br->in + br->pos) >> br->cnt;
+        br->pos += (size_t)((63 - br->cnt) >> 3);
+        br->cnt |= 56;
+        return;
+    }
+    while (br->cnt <= 56 && br->pos < br->size) {
+        br->buf |= (uint64_t)br->in[br->pos++] << (56 - br->cnt);
+        br->cnt += 8;
+    }
+}
+
+// ---------------- Tabla de decodificación ------------
+static int reserveEntries(struct DecodeTable* t, int n) {
+    if (t->count + n > t->capacity) {
+        int newCap = t->capacity ? t->capacity : (1 << HUFF_ROOT_BITS);
+        while (newCap < t->count + n) newCap *= 2;
+        struct DecodeEntry* tmp = realloc(t->entries, (size_t)newCap * sizeof(struct DecodeEntry));
+        if (!tmp) { perror("realloc"); return -1; }
+        t->entries  = tmp;
+        t->capacity = newCap;
+    }
+    int base = t->count;
+    memset(t->entries + base, 0, (size_t)n * sizeof(struct DecodeEntry));
+    t->count += n;
+    return base;
+}
+
+// Crea la tabla de un nivel para los símbolos 'syms', cuyos códigos comparten
+// los primeros 'consumed' bits, y resuelve los siguientes 'width' bits.
+// Devuelve el índice de la tabla creada o -1.
+static int buildLevel(struct DecodeTable* t, const struct HuffCode codes[HUFF_SYMBOLS],
+                      const unsigned char* syms, int n, int consumed, int width) {
+    int base = reserveEntries(t, 1 << width);
+    if (base < 0 || base > UINT16_MAX) return -1;
+
+    // Códigos que terminan en este nivel: rellenan todas las entradas que
+    // comparten su prefijo. Los más largos marcan un enlace pendiente.
+    for (int i = 0; i < n; i++) {
+        const struct HuffCode* c = &codes[syms[i]];
+        int rem = c->len - consumed;
+        uint64_t local = rem >= 64 ? c->bits : (c->bits & ((1ULL << rem) - 1));
+
+        if (rem <= width) {
+            int first = (int)(local << (width - rem));
+            int span  = 1 << (width - rem);
+            for (int k = 0; k < span; k++) {
+                struct DecodeEntry* e = &t->entries[base + first + k];
+                if (e->kind != DECODE_INVALID) return -1; // no es código prefijo
+                e->kind  = DECODE_SYMBOL;
+                e->value = syms[i];
+                e->bits  = (uint8_t)rem;
+            }
+        } else {
+            struct DecodeEntry* e = &t->entries[base + (int)(local >> (rem - width))];
+            if (e->kind == DECODE_SYMBOL) return -1;
+            int subWidth = rem - width < HUFF_SUB_BITS ? rem - width : HUFF_SUB_BITS;
+            e->kind = DECODE_LINK;
+            if (subWidth > e->bits) e->bits = (uint8_t)subWidth;
+        }
+    }
+
+    // Subtablas para los prefijos compartidos por códigos largos
+    for (int idx = 0; idx < (1 << width); idx++) {
+        if (t->entries[base + idx].kind != DECODE_LINK) continue;
+
+        unsigned char subset[HUFF_SYMBOLS];
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            const struct HuffCode* c = &codes[syms[i]];
+            int rem = c->len - consumed;
+            if (rem <= width) continue;
+            uint64_t local = rem >= 64 ? c->bits : (c->bits & ((1ULL << rem) - 1));
+            if ((int)(local >> (rem - width)) == idx) subset[m++] = syms[i];
+        }
+
+        int sub = buildLevel(t, codes, subset, m, consumed + width, t->entries[base + idx].bits);
+        if (sub < 0) return -1;
+        t->entries[base + idx].value = (uint16_t)sub; // 't->entries' pudo moverse
+    }
+    return base;
+}
+
+int buildDecodeTable(struct DecodeTable* table, const struct HuffCode codes[HUFF_SYMBOLS]) {
+    memset(table, 0, sizeof(*table));
+    if (rebuildDecodeTable(table, codes) != 0) {
+        freeDecodeTable(table);
+        return -1;
+    }
+    return 0;
+}
+
+int rebuildDecodeTable(struct DecodeTable* table, const struct HuffCode codes[HUFF_SYMBOLS]) {
+    table->count = 0;
+
+    unsigned char syms[HUFF_SYMBOLS];
+    int n = 0, maxLen = 0, minLen = HUFF_MAX_CODE_LEN;
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        if (codes[s].len <= 0) continue;
+        if (codes[s].len > HUFF_MAX_CODE_LEN) return -1;
+        syms[n++] = (unsigned char)s;
+        if (codes[s].len > maxLen) maxLen = codes[s].len;
+        if (codes[s].len < minLen) minLen = codes[s].len;
+    }
+    if (n == 0) return -1;
+
+    // Con longitudes acotadas una sola tabla resuelve cualquier código
+    table->rootBits = maxLen <= HUFF_SINGLE_LEVEL ? maxLen : HUFF_ROOT_BITS;
+    table->minLen   = minLen;
+    return buildLevel(table, codes, syms, n, 0, table->rootBits) == 0 ? 0 : -1;
+}
+
+void freeDecodeTable(struct DecodeTable* table) {
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+size_t decodedCapacity(const struct DecodeTable* table, uint64_t bitLen) {
+    return (size_t)(bitLen / (uint64_t)(table->minLen > 0 ? table->minLen : 1));
+}
+
+// ---------------- Decodificación ---------------------
+long long decodeBits(const struct DecodeTable* table, const unsigned char* in, size_t inBytes,
+                     uint64_t bitLen, unsigned char* out, size_t outCap) {
+    if (bitLen > (uint64_t)inBytes * 8) return -1;
+
+    const struct DecodeEntry* entries = table->entries;
+    const int rootBits = table->rootBits;
+    struct BitReader br = { in, 0, inBytes, 0, 0 };
+    uint64_t left = bitLen;
+    size_t n = 0;
+
+    while (left > 0) {
+        refillBits(&br);
+        const struct DecodeEntry* e = &entries[br.buf >> (64 - rootBits)];
+        int width = rootBits;
+
+        // Códigos largos: consumir el prefijo y seguir en la subtabla
+        while (e->kind == DECODE_LINK) {
+            if ((uint64_t)width > left) return -1;
+            br.buf <<= width;
+            br.cnt  -= width;
+            left    -= (uint64_t)width;
+            if (br.cnt < HUFF_SUB_BITS) refillBits(&br);
+            width = e->bits;
+            e = &entries[e->value + (br.buf >> (64 - width))];
+        }
+
+        if (e->kind != DECODE_SYMBOL || e->bits > left || n >= outCap) return -1;
+        out[n++] = (unsigned char)e->value;
+        br.buf <<= e->bits;
+        br.cnt  -= e->bits;
+        left    -= e->bits;
+    }
+    return (long long)n;
+}
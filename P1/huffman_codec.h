@@ -0,0 +1,135 @@
+#ifndef HUFFMAN_CODEC_H
+#define HUFFMAN_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HUFF_SYMBOLS      256
+#define HUFF_MAX_CODE_LEN 64   // el código debe caber en un uint64_t
+#define HUFF_ROOT_BITS    11   // bits resueltos por la tabla de primer nivel
+#define HUFF_SINGLE_LEVEL 12   // hasta esta longitud máxima basta una sola tabla
+#define HUFF_SUB_BITS     7    // ancho máximo de cada subtabla para códigos largos
+
+// ---------------- Códigos ----------------------------
+// Código de un símbolo como patrón de bits (el primer bit emitido es el más
+// significativo de los 'len' bits bajos). len == 0 => símbolo sin código.
+struct HuffCode {
+    uint64_t bits;
+    int      len;
+};
+
+// Asigna códigos canónicos a partir de las longitudes (0 = símbolo sin código):
+// los símbolos se ordenan por longitud y después por valor, y cada código es
+// el siguiente entero de su longitud. Devuelve -1 si las longitudes no
+// admiten un código prefijo.
+int assignCanonicalCodes(const uint8_t lens[HUFF_SYMBOLS], struct HuffCode codes[HUFF_SYMBOLS]);
+
+// ---------------- Histograma -------------------------
+// Suma a 'freq' las apariciones de cada byte de 'in'. Reparte los incrementos
+// entre cuatro subhistogramas de 32 bits para que un byte repetido no
+// encadene cada suma con la anterior; si la CPU tiene AVX2 además cuenta de
+// una vez los tramos de 32 bytes iguales.
+void countBytes(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]);
+// Núcleo portable, sin detección de CPU (lo usa countBytes como respaldo).
+void countBytesScalar(const unsigned char* in, size_t size, uint64_t freq[HUFF_SYMBOLS]);
+
+// ---------------- Longitudes limitadas ---------------
+// Longitudes óptimas con la restricción len <= maxLen (algoritmo
+// package-merge). Devuelve -1 si maxLen no alcanza para los símbolos usados.
+int limitCodeLengths(const uint64_t freq[HUFF_SYMBOLS], int maxLen, uint8_t lens[HUFF_SYMBOLS]);
+
+// Número de símbolos con frecuencia distinta de cero.
+int symbolCount(const uint64_t freq[HUFF_SYMBOLS]);
+
+// Bits totales que ocupan los datos con las longitudes dadas.
+uint64_t encodedBitCount(const uint64_t freq[HUFF_SYMBOLS], const uint8_t lens[HUFF_SYMBOLS]);
+
+// Longitudes de Huffman óptimas para 'freq', acotadas a 'limit' (0 = sin
+// límite pedido) y siempre a HUFF_MAX_CODE_LEN. Un único símbolo recibe
+// longitud 1. Devuelve 1 si el límite obligó a cambiarlas (con el coste en
+// bits antes y después), 0 si no y -1 si el límite es imposible.
+int buildCodeLengths(const uint64_t freq[HUFF_SYMBOLS], int limit, uint8_t lens[HUFF_SYMBOLS],
+                     uint64_t* optimalBits, uint64_t* limitedBits);
+
+// ---------------- Escritor de bits -------------------
+// Acumula los códigos en un registro de 64 bits (MSB primero) y vuelca
+// palabras completas al buffer empaquetado 'data'.
+struct BitWriter {
+    unsigned char* data;
+    size_t   size;      // bytes ya volcados en 'data'
+    size_t   capacity;
+    uint64_t acc;       // bits pendientes alineados a la izquierda
+    int      cnt;       // número de bits pendientes en 'acc' (0..63)
+    int      failed;    // se activa si no se pudo ampliar 'data'
+    int      fixed;     // 'data' es del llamador: no se amplía ni se libera
+};
+
+int  initBitWriter(struct BitWriter* bw, size_t capacityHint);
+// Escribe sobre un buffer del llamador (p. ej. memoria compartida) de
+// 'capacity' bytes; si no alcanza se activa 'failed' en lugar de crecer.
+void initBitWriterFixed(struct BitWriter* bw, unsigned char* buffer, size_t capacity);
+// Cota de bytes que ocupan 'symbols' símbolos con códigos de hasta 'maxLen' bits.
+size_t maxEncodedBytes(size_t symbols, int maxLen);
+void flushBitWriterWord(struct BitWriter* bw, uint64_t word);
+// Vuelca los bits pendientes (el último byte se rellena con ceros) y devuelve
+// el total de bits escritos. 'lastBitCount' recibe los bits útiles del último byte (1..8).
+uint64_t finishBitWriter(struct BitWriter* bw, int* lastBitCount);
+void freeBitWriter(struct BitWriter* bw);
+
+// Añade los 'len' bits bajos de 'bits' (1 <= len <= 64).
+static inline void putBits(struct BitWriter* bw, uint64_t bits, int len) {
+    int room = 64 - bw->cnt;
+    if (len < room) {
+        bw->acc |= bits << (room - len);
+        bw->cnt += len;
+        return;
+    }
+    // La palabra se completa: volcarla y quedarse con los bits sobrantes
+    int rest = len - room;
+    flushBitWriterWord(bw, bw->acc | (bits >> rest));
+    bw->cnt = rest;
+    bw->acc = rest ? bits << (64 - rest) : 0;
+}
+
+// Codifica 'size' bytes con la tabla indexada por valor de byte: una carga
+// por símbolo. Devuelve -1 si aparece un byte sin código.
+int encodeBytes(const struct HuffCode codes[HUFF_SYMBOLS], const unsigned char* in, size_t size,
+                struct BitWriter* bw);
+
+// ---------------- Tabla de decodificación ------------
+// Cada entrada resuelve 'bits' bits del flujo: o bien emite un símbolo, o bien
+// enlaza con una subtabla de 2^bits entradas que empieza en 'value'.
+enum { DECODE_INVALID = 0, DECODE_SYMBOL = 1, DECODE_LINK = 2 };
+
+struct DecodeEntry {
+    uint16_t value;  // símbolo o índice de la subtabla
+    uint8_t  bits;   // bits consumidos (símbolo) o ancho de la subtabla (enlace)
+    uint8_t  kind;
+};
+
+struct DecodeTable {
+    struct DecodeEntry* entries;  // tabla raíz en [0, 2^rootBits) y subtablas detrás
+    int count;
+    int capacity;
+    int rootBits;
+    int minLen;                   // longitud del código más corto
+};
+
+// Construye la tabla a partir de los códigos indexados por símbolo.
+// Devuelve 0 si los códigos forman un código prefijo válido, -1 en otro caso.
+int  buildDecodeTable(struct DecodeTable* table, const struct HuffCode codes[HUFF_SYMBOLS]);
+// Igual que buildDecodeTable pero reutiliza la memoria de una tabla ya
+// construida (o a cero). Si falla, la tabla no es válida hasta reconstruirla.
+int  rebuildDecodeTable(struct DecodeTable* table, const struct HuffCode codes[HUFF_SYMBOLS]);
+void freeDecodeTable(struct DecodeTable* table);
+
+// Decodifica 'bitLen' bits empaquetados (MSB primero) directamente desde 'in'.
+// Escribe como máximo 'outCap' símbolos en 'out' y devuelve cuántos escribió,
+// o -1 si el flujo está corrupto o no cabe en 'out'.
+long long decodeBits(const struct DecodeTable* table, const unsigned char* in, size_t inBytes,
+                     uint64_t bitLen, unsigned char* out, size_t outCap);
+
+// Cota superior de símbolos que pueden salir de 'bitLen' bits.
+size_t decodedCapacity(const struct DecodeTable* table, uint64_t bitLen);
+
+#endif
@@ -1,53 +1,36 @@
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <stdint.h>
+#include <unistd.h>
 
-#define MAX_FILES    100
-#define MAX_FILENAME 256
-#define MAX_CHARS    256
-#define MAX_TREE_HT  256
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_lib.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
+
+#define STREAM_CHUNK (64 * 1024) // lectura en modo streaming (-s)
 
 // --------------------- Estructuras ---------------------
 
 struct FileInfo {
-    char filename[MAX_FILENAME];
-    char* content;
-    int   size;
-};
-
-struct FreqMap {
-    char character;
-    uint64_t frequency;
-    int used;
-};
-
-struct CodeMap {
-    char character;
-    char code[MAX_TREE_HT]; // '\0' al final
-    int used;
-};
-
-struct MinHeapNode {
-    char data;
-    uint64_t freq;
-    struct MinHeapNode *left, *right;
-};
-
-struct MinHeap {
-    int size;
-    int capacity;
-    struct MinHeapNode** array;
+    const char* filename;      // ruta relativa a la raíz (de la FileList)
+    const char* path;
+    const char* content;       // apunta a la proyección de 'input' (NULL con -s)
+    size_t size;
+    struct MappedFile input;
 };
 
 // ---------------- Variables globales ------------------
-static struct FreqMap freqTab[MAX_CHARS];
-static struct CodeMap codes[MAX_CHARS];
-static int freqCount = 0;
-static int codeCount = 0;
+static uint8_t codeLens[HUFF_SYMBOLS];          // longitud del código de cada byte
+static struct HuffCode codeTable[HUFF_SYMBOLS]; // códigos canónicos indexados por byte
+static struct RunStats stats;                   // --stats=json
 
 // ---------------- Utilidades --------------------------
 static long long elapsedMillis(struct timeval start, struct timeval end) {
@@ -57,394 +40,543 @@ static long long elapsedMillis(struct timeval start, struct timeval end) {
     return seconds * 1000LL + microseconds / 1000LL;
 }
 
-// ---------------- MinHeap -----------------------------
-static struct MinHeapNode* newNode(char data, uint64_t freq) {
-    struct MinHeapNode* node = (struct MinHeapNode*)malloc(sizeof(struct MinHeapNode));
-    if (!node) { perror("malloc"); exit(1); }
-    node->left = node->right = NULL;
-    node->data = data;
-    node->freq = freq;
-    return node;
-}
-
-static struct MinHeap* createMinHeap(int capacity) {
-    struct MinHeap* minHeap = (struct MinHeap*)malloc(sizeof(struct MinHeap));
-    if (!minHeap) { perror("malloc"); exit(1); }
-    minHeap->size = 0;
-    minHeap->capacity = capacity > 0 ? capacity : 1; // evita malloc(0)
-    minHeap->array = (struct MinHeapNode**)malloc(minHeap->capacity * sizeof(struct MinHeapNode*));
-    if (!minHeap->array) { perror("malloc"); exit(1); }
-    return minHeap;
-}
-
-static void swapMinHeapNode(struct MinHeapNode** a, struct MinHeapNode** b) {
-    struct MinHeapNode* t = *a; *a = *b; *b = t;
-}
-
-static void minHeapify(struct MinHeap* minHeap, int idx) {
-    int smallest = idx;
-    int left = 2 * idx + 1, right = 2 * idx + 2;
-
-    if (left < minHeap->size && minHeap->array[left]->freq < minHeap->array[smallest]->freq)
-        smallest = left;
-    if (right < minHeap->size && minHeap->array[right]->freq < minHeap->array[smallest]->freq)
-        smallest = right;
-
-    if (smallest != idx) {
-        swapMinHeapNode(&minHeap->array[smallest], &minHeap->array[idx]);
-        minHeapify(minHeap, smallest);
+// ---------------- Frecuencias -------------------------
+// Conteo O(n) usando un bucket de 256 por byte
+static void count_all_files_into_buckets(struct FileInfo* files, int fileCount, uint64_t buckets[256], uint64_t* totalSize) {
+    memset(buckets, 0, 256 * sizeof(uint64_t));
+    *totalSize = 0;
+    for (int i = 0; i < fileCount; i++) {
+        uint64_t t0 = monotonicNs();
+        countBytes((const unsigned char*)files[i].content, files[i].size, buckets);
+        statsPhase(&stats, STAT_HISTOGRAM, t0, files[i].size, 0);
+        *totalSize += files[i].size;
     }
 }
 
-static int isSizeOne(struct MinHeap* minHeap) { return (minHeap->size == 1); }
-
-static struct MinHeapNode* extractMin(struct MinHeap* minHeap) {
-    // Precondición: size > 0
-    struct MinHeapNode* temp = minHeap->array[0];
-    minHeap->array[0] = minHeap->array[minHeap->size - 1];
-    --minHeap->size;
-    if (minHeap->size > 0) minHeapify(minHeap, 0);
-    return temp;
-}
-
-static void insertMinHeap(struct MinHeap* minHeap, struct MinHeapNode* minHeapNode) {
-    int i = minHeap->size++;
-    // burbujea hacia arriba
-    while (i && minHeapNode->freq < minHeap->array[(i - 1) / 2]->freq) {
-        minHeap->array[i] = minHeap->array[(i - 1) / 2];
-        i = (i - 1) / 2;
-    }
-    minHeap->array[i] = minHeapNode;
+// ---------------- Archivos ----------------------------
+// Proyecta el archivo en memoria: los pases de frecuencias y de codificación
+// leen directamente de la proyección, sin copiarlo a un buffer propio.
+static const char* readFile(const char* filename, struct MappedFile* input, size_t* size) {
+    if (mapFileReadOnly(filename, input, POSIX_MADV_SEQUENTIAL) != 0) return NULL;
+    *size = input->size;
+    return (const char*)input->data;
 }
 
-// ---------------- Huffman -----------------------------
-static void storeCodes(struct MinHeapNode* root, char* buffer, int depth) {
-    if (!root) return;
-
-    // hoja
-    if (!root->left && !root->right) {
-        buffer[depth] = '\0';
-        codes[codeCount].character = root->data;
-        memcpy(codes[codeCount].code, buffer, (size_t)depth + 1);
-        codes[codeCount].used = 1;
-        codeCount++;
-        return;
+// Recorre el árbol (recursivo, de mayor a menor tamaño) y proyecta cada
+// archivo. Con 'streaming' no se proyecta nada: el tamaño viene del recorrido
+// y los dos pases leen el archivo por trozos.
+static int readDirectory(const char* dirPath, struct FileList* list, struct FileInfo** filesOut, int streaming) {
+    *filesOut = NULL;
+    uint64_t t0 = monotonicNs();
+    if (walkDirectory(dirPath, 1, list) != 0) {
+        printf("Error: No se pudo abrir el directorio %s\n", dirPath);
+        return 0;
     }
+    sortLargestFirst(list);
+    statsPhase(&stats, STAT_SCAN, t0, 0, 0);
 
-    buffer[depth] = '0';
-    storeCodes(root->left, buffer, depth + 1);
-
-    buffer[depth] = '1';
-    storeCodes(root->right, buffer, depth + 1);
-}
-
-static struct MinHeapNode* buildHuffmanTree_safe(void) {
-    // Recolectar símbolos usados (garantiza que capacity = usados)
-    int usedCount = 0;
-    for (int i = 0; i < MAX_CHARS; i++)
-        if (freqTab[i].used && freqTab[i].frequency > 0) usedCount++;
-
-    if (usedCount == 0) {
-        // No hay datos: no construir árbol
-        return NULL;
+    struct FileInfo* files = calloc((size_t)(list->count > 0 ? list->count : 1), sizeof(struct FileInfo));
+    if (!files) {
+        perror("calloc");
+        return 0;
     }
 
-    // Caso especial: un solo símbolo => código "0"
-    if (usedCount == 1) {
-        struct MinHeapNode* root = NULL;
-        for (int i = 0; i < MAX_CHARS; i++) {
-            if (freqTab[i].used && freqTab[i].frequency > 0) {
-                root = newNode(freqTab[i].character, freqTab[i].frequency);
-                break;
-            }
+    int fileCount = 0;
+    for (int i = 0; i < list->count; i++) {
+        struct FileInfo* file = &files[fileCount];
+        file->filename = list->entries[i].name;
+        file->path     = list->entries[i].path;
+
+        int ok;
+        if (streaming) {
+            file->size = (size_t)list->entries[i].size;
+            ok = 1;
+        } else {
+            // Solo se proyecta: las páginas se leen al contar frecuencias
+            t0 = monotonicNs();
+            file->content = readFile(file->path, &file->input, &file->size);
+            ok = file->content != NULL;
+            statsPhase(&stats, STAT_READ, t0, ok ? file->size : 0, 0);
         }
-        // Asignar código "0"
-        codes[0].character = root->data;
-        codes[0].code[0] = '0';
-        codes[0].code[1] = '\0';
-        codes[0].used = 1;
-        codeCount = 1;
-        return root;
-    }
-
-    struct MinHeap* minHeap = createMinHeap(usedCount);
-
-    for (int i = 0; i < MAX_CHARS; i++) {
-        if (freqTab[i].used && freqTab[i].frequency > 0) {
-            insertMinHeap(minHeap, newNode(freqTab[i].character, freqTab[i].frequency));
+        if (ok) {
+            printf("Archivo leído: %s (%zu bytes)\n", file->filename, file->size);
+            fileCount++;
         }
     }
 
-    while (!isSizeOne(minHeap)) {
-        struct MinHeapNode* left  = extractMin(minHeap);
-        struct MinHeapNode* right = extractMin(minHeap);
-        struct MinHeapNode* top   = newNode('\0', left->freq + right->freq);
-        top->left = left; top->right = right;
-        insertMinHeap(minHeap, top);
-    }
-
-    struct MinHeapNode* root = extractMin(minHeap);
-
-    char buffer[MAX_TREE_HT];
-    codeCount = 0;
-    storeCodes(root, buffer, 0);
-
-    free(minHeap->array);
-    free(minHeap);
-    return root;
-}
-
-// ---------------- Frecuencias -------------------------
-// Conteo O(n) usando un bucket de 256 y luego volcamos a freqTab
-static void count_all_files_into_buckets(struct FileInfo* files, int fileCount, uint64_t buckets[256], long* totalSize) {
-    memset(buckets, 0, 256 * sizeof(uint64_t));
-    *totalSize = 0;
-    for (int i = 0; i < fileCount; i++) {
-        const unsigned char* p = (const unsigned char*)files[i].content;
-        for (int k = 0; k < files[i].size; k++) buckets[p[k]]++;
-        *totalSize += files[i].size;
-    }
+    *filesOut = files;
+    return fileCount;
 }
 
-static void buckets_to_freqtab(const uint64_t buckets[256]) {
-    memset(freqTab, 0, sizeof(freqTab));
-    freqCount = 0;
-    for (int i = 0; i < 256; i++) {
-        if (buckets[i] > 0) {
-            freqTab[freqCount].character = (char)i;
-            freqTab[freqCount].frequency = buckets[i];
-            freqTab[freqCount].used = 1;
-            freqCount++;
-        }
+// ---------------- Streaming ---------------------------
+// Primer pase: histograma leyendo por trozos de STREAM_CHUNK bytes.
+static int streamCountFile(struct FileInfo* file, unsigned char* chunk, uint64_t buckets[256]) {
+    FILE* in = fopen(file->path, "rb");
+    if (!in) {
+        perror(file->path);
+        return -1;
     }
-}
-
-static char* getCode(char c) {
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used && codes[i].character == c) return codes[i].code;
+    size_t n, total = 0;
+    for (;;) {
+        uint64_t t0 = monotonicNs();
+        n = fread(chunk, 1, STREAM_CHUNK, in);
+        statsPhase(&stats, STAT_READ, t0, n, 0);
+        if (n == 0) break;
+        t0 = monotonicNs();
+        countBytes(chunk, n, buckets);
+        statsPhase(&stats, STAT_HISTOGRAM, t0, n, 0);
+        total += n;
     }
-    // Si no se encuentra (no debería pasar), retorna código vacío
-    return "";
+    int rc = ferror(in) ? -1 : 0;
+    fclose(in);
+    // El tamaño debe ser el mismo en los dos pases
+    file->size = total;
+    return rc;
 }
 
-// ---------------- Archivos ----------------------------
-static char* readFile(const char* filename, int* size) {
-    FILE* file = fopen(filename, "rb");   // binario
-    if (!file) return NULL;
-
-    if (fseek(file, 0, SEEK_END) != 0) { fclose(file); return NULL; }
-    long fsz = ftell(file);
-    if (fsz < 0) { fclose(file); return NULL; }
-    *size = (int)fsz;
-    rewind(file);
-
-    char* content = (char*)malloc((size_t)(*size) + 1);
-    if (!content) { fclose(file); return NULL; }
-
-    size_t n = fread(content, 1, (size_t)*size, file);
-    if ((int)n != *size) {
-        // lectura parcial; aún así aseguramos terminador para funciones que lo usen
-        content[n] = '\0';
-    } else {
-        content[*size] = '\0';
+// Con -a, histograma del tramo de 'len' bytes que empieza en la posición
+// actual de 'in', que vuelve a dejarse donde estaba para codificarlo después.
+static int streamCountBlock(FILE* in, size_t len, unsigned char* chunk, uint64_t freq[HUFF_SYMBOLS]) {
+    off_t start = ftello(in);
+    if (start < 0) return -1;
+    memset(freq, 0, HUFF_SYMBOLS * sizeof(uint64_t));
+    for (size_t got = 0; got < len; ) {
+        size_t want = len - got < STREAM_CHUNK ? len - got : STREAM_CHUNK;
+        uint64_t t0 = monotonicNs();
+        if (fread(chunk, 1, want, in) != want) return -1;
+        statsPhase(&stats, STAT_READ, t0, want, 0);
+        t0 = monotonicNs();
+        countBytes(chunk, want, freq);
+        statsPhase(&stats, STAT_HISTOGRAM, t0, want, 0);
+        got += want;
     }
-    fclose(file);
-    return content;
+    return fseeko(in, start, SEEK_SET);
 }
 
-static int readDirectory(const char* dirPath, struct FileInfo* files) {
-    DIR* dir = opendir(dirPath);
-    if (!dir) {
-        printf("Error: No se pudo abrir el directorio %s\n", dirPath);
-        return 0;
+// Segundo pase: codifica por trozos y vuelca el empaquetado al archivo de
+// salida en cuanto se llena 'bw', que es un buffer fijo.
+static int streamEncodeFile(FILE* outFile, struct ArchiveToc* toc, const struct FileInfo* file,
+                            int blockSize, const struct BlockCoder* coder, unsigned char* chunk,
+                            struct BitWriter* bw, uint64_t* encodedLen, int* blockCount) {
+    FILE* in = fopen(file->path, "rb");
+    if (!in) {
+        perror(file->path);
+        return -1;
     }
 
-    struct dirent* entry;
-    int fileCount = 0;
-    char fullPath[1024];
-
-    while ((entry = readdir(dir)) != NULL && fileCount < MAX_FILES) {
-        // solo .txt (sencillo)
-        const char* name = entry->d_name;
-        const char* ext  = strstr(name, ".txt");
-        if (ext && ext[4] == '\0') {
-            snprintf(fullPath, sizeof(fullPath), "%s/%s", dirPath, name);
-            strncpy(files[fileCount].filename, name, MAX_FILENAME - 1);
-            files[fileCount].filename[MAX_FILENAME - 1] = '\0';
-
-            files[fileCount].content = readFile(fullPath, &files[fileCount].size);
-            if (files[fileCount].content != NULL) {
-                printf("Archivo leído: %s (%d bytes)\n", name, files[fileCount].size);
-                fileCount++;
+    struct RecordWriter rw;
+    int rc = beginFileRecord(outFile, &rw, file->filename, file->size, blockSize);
+    size_t step = blockSize > 0 ? (size_t)blockSize : file->size;
+    size_t done = 0;
+
+    for (int b = 0; rc == 0 && b < rw.blockCount; b++) {
+        size_t len = file->size - done < step ? file->size - done : step;
+        uint64_t bits = 0;
+
+        // La cabecera del bloque no cuenta en sus bits
+        struct BlockTable table;
+        uint64_t freq[HUFF_SYMBOLS];
+        if ((coder->adaptive && streamCountBlock(in, len, chunk, freq) != 0) ||
+            chooseBlockTable(coder, coder->adaptive ? freq : NULL, &table) != 0 ||
+            fwrite(table.head, 1, (size_t)table.headBytes, outFile) != (size_t)table.headBytes) {
+            rc = -1;
+            break;
+        }
+        for (size_t got = 0; rc == 0 && got < len; ) {
+            size_t want = len - got < STREAM_CHUNK ? len - got : STREAM_CHUNK;
+            uint64_t t0 = monotonicNs();
+            if (fread(chunk, 1, want, in) != want) {
+                rc = -1;
+                break;
             }
+            statsPhase(&stats, STAT_READ, t0, want, 0);
+            t0 = monotonicNs();
+            if (encodeBytes(table.codes, chunk, want, bw) != 0) {
+                rc = -1;
+                break;
+            }
+            statsPhase(&stats, STAT_ENCODE, t0, want, bw->size);
+            t0 = monotonicNs();
+            long long drained = drainBitWriter(outFile, bw);
+            if (drained < 0) rc = -1;
+            else bits += (uint64_t)drained * 8;
+            statsPhase(&stats, STAT_WRITE, t0, 0, drained > 0 ? (uint64_t)drained : 0);
+            got += want;
         }
+        if (rc != 0) break;
+        // Cada bloque termina alineado a byte
+        bits += finishBitWriter(bw, NULL);
+        if (drainBitWriter(outFile, bw) < 0 || closeRecordBlock(&rw, bits) != 0) rc = -1;
+        done += len;
     }
+    if (rc == 0 && fgetc(in) != EOF) rc = -1; // el archivo creció entre los pases
+    if (rc == 0) rc = endFileRecord(&rw, toc, file->filename);
 
-    closedir(dir);
-    return fileCount;
+    fclose(in);
+    *encodedLen = rw.totalBits;
+    *blockCount = rw.blockCount;
+    return rc;
 }
 
-// ---------------- Binario -----------------------------
-static void stringToBinary(const char* binStr, FILE* outFile) {
-    int len = (int)strlen(binStr);
-    unsigned char byte = 0;
-    int bitCount = 0;
-
-    for (int i = 0; i < len; i++) {
-        byte = (byte << 1) | (unsigned char)(binStr[i] - '0');
-        bitCount++;
-        if (bitCount == 8) {
-            fwrite(&byte, 1, 1, outFile);
-            byte = 0;
-            bitCount = 0;
-        }
+// ---------------- Tubería (-p) -------------------------
+// Lee hasta 'size' bytes; solo devuelve menos al llegar al final de 'in'.
+static size_t readFull(FILE* in, unsigned char* buffer, size_t size) {
+    size_t total = 0, n;
+    while (total < size && (n = fread(buffer + total, 1, size - total, in)) > 0) total += n;
+    return total;
+}
+
+// Comprime 'in' en 'out' por bloques, cada uno con su propia tabla: no hace
+// falta conocer la entrada completa y la memoria depende solo de blockSize.
+// Las tramas las produce libhuffman, igual que compressBuffer.
+static int compressPipe(FILE* in, FILE* out, int blockSize, int maxLenLimit) {
+    struct HuffmanCompressor ctx;
+    if (initHuffmanCompressor(&ctx, blockSize, maxLenLimit) != 0) return -1;
+    ctx.stats = &stats;
+
+    size_t frameCap = frameBound((size_t)blockSize);
+    unsigned char* block = malloc((size_t)blockSize);
+    unsigned char* frame = malloc(frameCap);
+    if (!block || !frame) {
+        perror("malloc");
+        free(block);
+        free(frame);
+        return -1;
     }
 
-    int lastBits;
-    if (bitCount > 0) {
-        byte <<= (8 - bitCount);
-        fwrite(&byte, 1, 1, outFile);
-        lastBits = bitCount;
-    } else {
-        lastBits = 8;
+    int rc = writePipeHeader(out);
+    size_t n;
+    for (;;) {
+        uint64_t t0 = monotonicNs();
+        n = rc == 0 ? readFull(in, block, (size_t)blockSize) : 0;
+        if (n == 0) break;
+        statsPhase(&stats, STAT_READ, t0, n, 0);
+
+        long long bytes = compressFrame(&ctx, block, n, frame, frameCap);
+        if (bytes < 0) {
+            rc = -1;
+            break;
+        }
+
+        t0 = monotonicNs();
+        if (fwrite(frame, 1, (size_t)bytes, out) != (size_t)bytes) rc = -1;
+        statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)bytes);
     }
-    fwrite(&lastBits, sizeof(int), 1, outFile);
+    if (rc == 0 && ferror(in)) rc = -1;
+    if (rc == 0) rc = writePipeEnd(out);
+    if (rc == 0 && fflush(out) != 0) rc = -1;
+
+    freeHuffmanCompressor(&ctx);
+    free(block);
+    free(frame);
+    return rc;
 }
 
-// ---------------- Main -------------------------------
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Uso: %s <directorio_entrada> <archivo_salida.bin>\n", argv[0]);
+// ---------------- Motor serie -------------------------
+// --engine=serial: un solo hilo; con -s cada archivo se recorre dos veces con
+// buffers fijos.
+int compressSerial(const struct CompressOptions* options) {
+    int maxLenLimit = options->maxLen;
+    int blockSize   = options->blockSize;
+    int streaming   = options->streaming;
+    if (statsInit(&stats, "huffman_compressor", options->statsJson, 0) != 0) {
+        perror("calloc");
         return 1;
     }
+    const char* inputDir   = options->inputDir;
+    const char* outputPath = options->outputPath;
 
     struct timeval startTime, endTime;
     gettimeofday(&startTime, NULL);
 
-    struct FileInfo files[MAX_FILES];
-    memset(files, 0, sizeof(files));
-    memset(freqTab, 0, sizeof(freqTab));
-    memset(codes,   0, sizeof(codes));
-    freqCount = 0;
-    codeCount = 0;
+    memset(codeLens,  0, sizeof(codeLens));
+    memset(codeTable, 0, sizeof(codeTable));
 
     // 1) Leer archivos
-    int fileCount = readDirectory(argv[1], files);
+    struct FileList list;
+    struct FileInfo* files;
+    int fileCount = readDirectory(inputDir, &list, &files, streaming);
     if (fileCount == 0) {
         printf("No se encontraron archivos .txt en el directorio\n");
         return 1;
     }
+    if (statsInitFiles(&stats, fileCount) != 0) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < stats.fileCount; i++) stats.files[i].name = files[i].filename;
 
     // 2) Contar frecuencias O(n)
     uint64_t buckets[256];
-    long totalSize = 0;
-    count_all_files_into_buckets(files, fileCount, buckets, &totalSize);
-    buckets_to_freqtab(buckets);
-
-    printf("\nCalculando frecuencias de %ld caracteres... símbolos distintos: %d\n",
-           totalSize, freqCount);
-
-    // 3) Construir árbol de Huffman seguro (maneja 0/1 símbolos)
-    struct MinHeapNode* root = buildHuffmanTree_safe();
-    if (freqCount > 0 && !root) {
-        fprintf(stderr, "Error construyendo el árbol de Huffman\n");
+    uint64_t totalSize = 0;
+    unsigned char* chunk = NULL;
+    if (streaming) {
+        chunk = malloc(STREAM_CHUNK);
+        if (!chunk) { perror("malloc"); return 1; }
+        memset(buckets, 0, sizeof(buckets));
+        for (int i = 0; i < fileCount; i++) {
+            if (streamCountFile(&files[i], chunk, buckets) != 0) {
+                printf("Error: No se pudo leer %s\n", files[i].path);
+                return 1;
+            }
+            totalSize += files[i].size;
+        }
+    } else {
+        count_all_files_into_buckets(files, fileCount, buckets, &totalSize);
+    }
+    int symbols = symbolCount(buckets);
+
+    printf("\nCalculando frecuencias de %llu caracteres... símbolos distintos: %d\n",
+           (unsigned long long)totalSize, symbols);
+
+    // 3) Longitudes de Huffman (0/1 símbolos incluidos), limitadas a -L o a
+    //    64 bits como máximo
+    uint64_t treeStart = monotonicNs();
+    uint64_t optimalBits = 0, limitedBits = 0;
+    int limited = buildCodeLengths(buckets, maxLenLimit, codeLens, &optimalBits, &limitedBits);
+    if (limited < 0) {
+        printf("Error: %d bits no alcanzan para %d símbolos\n", maxLenLimit, symbols);
         return 1;
     }
+    if (limited > 0) {
+        printf("Códigos limitados a %d bits: %llu -> %llu bits (+%.3f%%)\n",
+               maxLenLimit > 0 ? maxLenLimit : HUFF_MAX_CODE_LEN,
+               (unsigned long long)optimalBits, (unsigned long long)limitedBits,
+               optimalBits ? 100.0 * (double)(limitedBits - optimalBits) / (double)optimalBits : 0.0);
+    }
 
     // 4) Archivo de salida
-    FILE* outFile = fopen(argv[2], "wb");
+    FILE* outFile = fopen(outputPath, "wb");
     if (!outFile) {
         perror("fopen salida");
         return 1;
     }
 
-    // Cabecera simple: #archivos y #códigos
-    fwrite(&fileCount, sizeof(int), 1, outFile);
-    fwrite(&codeCount, sizeof(int), 1, outFile);
-
-    // Tabla de códigos
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used) {
-            fwrite(&codes[i].character, sizeof(char), 1, outFile);
-            int codeLen = (int)strlen(codes[i].code);
-            fwrite(&codeLen, sizeof(int), 1, outFile);
-            fwrite(codes[i].code, sizeof(char), (size_t)codeLen, outFile);
-        }
+    // Los códigos canónicos se empaquetan en un registro de 64 bits
+    if (assignCanonicalCodes(codeLens, codeTable) != 0) {
+        fprintf(stderr, "Error: algún código supera %d bits\n", HUFF_MAX_CODE_LEN);
+        fclose(outFile);
+        return 1;
     }
 
-    // Determinar longitud máxima de código para dimensionar buffers
-    int maxCodeLen = 1;
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used) {
-            int L = (int)strlen(codes[i].code);
-            if (L > maxCodeLen) maxCodeLen = L;
-        }
-    }
+    statsPhase(&stats, STAT_TREE, treeStart, 0, 0);
 
-    // 5) Codificar cada archivo
-    for (int i = 0; i < fileCount; i++) {
-        // nombre
-        int nameLen = (int)strlen(files[i].filename);
-        fwrite(&nameLen, sizeof(int), 1, outFile);
-        fwrite(files[i].filename, sizeof(char), (size_t)nameLen, outFile);
-
-        // tamaño conservador del buffer de bits (caracteres * long máx)
-        size_t encCap = (size_t)files[i].size * (size_t)maxCodeLen + 1;
-        char* encodedContent = (char*)malloc(encCap);
-        if (!encodedContent) { perror("malloc encoded"); fclose(outFile); return 1; }
-
-        int pos = 0;
-        for (int j = 0; j < files[i].size; j++) {
-            char* code = getCode(files[i].content[j]);
-            int len = (int)strlen(code);
-            if (len > 0) {
-                // aseguramos no rebasar (muy conservador por encCap)
-                if ((size_t)(pos + len + 1) > encCap) {
-                    // re-dimensionar si hiciera falta (raro con encCap correcto)
-                    size_t newCap = encCap * 2 + len + 1;
-                    char* tmp = (char*)realloc(encodedContent, newCap);
-                    if (!tmp) { perror("realloc"); free(encodedContent); fclose(outFile); return 1; }
-                    encodedContent = tmp;
-                    encCap = newCap;
-                }
-                memcpy(encodedContent + pos, code, (size_t)len);
-                pos += len;
-            } else {
-                // Caso borde: un solo símbolo en todo el dataset con código "0"
-                // len==0 no debería ocurrir con nuestro manejo; por seguridad:
-                if (codeCount == 1) {
-                    if ((size_t)(pos + 2) > encCap) {
-                        size_t newCap = encCap * 2 + 2;
-                        char* tmp = (char*)realloc(encodedContent, newCap);
-                        if (!tmp) { perror("realloc"); free(encodedContent); fclose(outFile); return 1; }
-                        encodedContent = tmp;
-                        encCap = newCap;
-                    }
-                    encodedContent[pos++] = '0';
-                }
+    // Cabecera: #archivos y solo las longitudes de código
+    uint64_t t0 = monotonicNs();
+    if (writeArchiveHeader(outFile, fileCount, blockSize, codeLens) != 0) {
+        perror("fwrite cabecera");
+        fclose(outFile);
+        return 1;
+    }
+    statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)ftello(outFile));
+
+    // 5) Codificar cada archivo (por bloques si se pidió -b; con -a cada
+    //    bloque puede llevar su propia tabla)
+    struct BlockCoder coder = { codeLens, codeTable, maxLenLimit, options->adaptive };
+    struct ArchiveToc toc = {0};
+    if (streaming) {
+        // Un trozo de entrada produce como mucho maxEncodedBytes de salida
+        size_t outCap = maxEncodedBytes(STREAM_CHUNK, HUFF_MAX_CODE_LEN);
+        unsigned char* outChunk = malloc(outCap);
+        if (!outChunk) { perror("malloc"); fclose(outFile); return 1; }
+        struct BitWriter bw;
+        initBitWriterFixed(&bw, outChunk, outCap);
+
+        for (int i = 0; i < fileCount; i++) {
+            uint64_t encodedLen = 0;
+            int blockCount = 0;
+            uint64_t fileStart = monotonicNs();
+            off_t recordStart = ftello(outFile);
+            if (streamEncodeFile(outFile, &toc, &files[i], blockSize, &coder, chunk, &bw,
+                                 &encodedLen, &blockCount) != 0) {
+                fprintf(stderr, "Error codificando %s\n", files[i].filename);
+                fclose(outFile);
+                return 1;
             }
+            statsFile(&stats, i, files[i].size, (uint64_t)(ftello(outFile) - recordStart),
+                      monotonicNs() - fileStart);
+            printf("Archivo %s codificado: %llu -> %llu bits (%d bloques)\n",
+                   files[i].filename, (unsigned long long)files[i].size * 8,
+                   (unsigned long long)encodedLen, blockCount);
         }
-        encodedContent[pos] = '\0';
-
-        int encodedLen = pos; // bits
-        fwrite(&encodedLen, sizeof(int), 1, outFile);
+        freeBitWriter(&bw);
+        free(outChunk);
+        free(chunk);
+    } else {
+        for (int i = 0; i < fileCount; i++) {
+            const unsigned char* content = (const unsigned char*)files[i].content;
+            size_t size = files[i].size;
+            int blockCount = blockCountFor(size, blockSize);
+            struct EncodedBlock* blocks = calloc((size_t)(blockCount > 0 ? blockCount : 1), sizeof(struct EncodedBlock));
+            if (!blocks) { perror("calloc"); fclose(outFile); return 1; }
+
+            // Empaquetado directo: sin cadena intermedia de '0'/'1'
+            uint64_t fileStart = monotonicNs();
+            uint64_t encodedLen = 0; // bits
+            for (int b = 0; b < blockCount; b++) {
+                size_t start = blockSize > 0 ? (size_t)b * (size_t)blockSize : 0;
+                size_t len   = blockSize > 0 && size - start > (size_t)blockSize ? (size_t)blockSize : size - start;
+                t0 = monotonicNs();
+                if (encodeBlock(&coder, content + start, len, &blocks[b]) != 0) {
+                    fprintf(stderr, "Error codificando %s\n", files[i].filename);
+                    fclose(outFile);
+                    return 1;
+                }
+                statsPhase(&stats, STAT_ENCODE, t0, len, blocks[b].bytes);
+                encodedLen += blocks[b].bits;
+            }
 
-        stringToBinary(encodedContent, outFile);
+            off_t recordStart = ftello(outFile);
+            t0 = monotonicNs();
+            if (writeFileRecord(outFile, &toc, files[i].filename, size, blockSize, blocks, blockCount) != 0) {
+                perror("fwrite");
+                fclose(outFile);
+                return 1;
+            }
+            uint64_t recordBytes = (uint64_t)(ftello(outFile) - recordStart);
+            statsPhase(&stats, STAT_WRITE, t0, 0, recordBytes);
+            statsFile(&stats, i, size, recordBytes, monotonicNs() - fileStart);
 
-        printf("Archivo %s codificado: %d -> %d bits\n",
-               files[i].filename, files[i].size * 8, encodedLen);
+            printf("Archivo %s codificado: %llu -> %llu bits (%d bloques)\n",
+                   files[i].filename, (unsigned long long)size * 8, (unsigned long long)encodedLen, blockCount);
 
-        free(encodedContent);
-        free(files[i].content);
-        files[i].content = NULL;
+            for (int b = 0; b < blockCount; b++) free(blocks[b].data);
+            free(blocks);
+            unmapFile(&files[i].input);
+            files[i].content = NULL;
+        }
     }
 
+    // 6) Índice al final para extraer archivos sueltos
+    off_t tocStart = ftello(outFile);
+    t0 = monotonicNs();
+    if (writeArchiveToc(outFile, &toc) != 0) {
+        perror("fwrite índice");
+        fclose(outFile);
+        return 1;
+    }
+    statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)(ftello(outFile) - tocStart));
+    freeArchiveToc(&toc);
     fclose(outFile);
+    free(files);
+    freeFileList(&list);
 
     gettimeofday(&endTime, NULL);
     long long totalMs = elapsedMillis(startTime, endTime);
-    printf("\nCompresión completada: %s\n", argv[2]);
+    printf("\nCompresión completada: %s\n", outputPath);
     printf("Tiempo total de compresión: %lld ms\n", totalMs);
 
+    statsWriteJson(&stats, stderr);
+    statsFree(&stats);
     return 0;
 }
+
+// ---------------- Main -------------------------------
+static void printUsage(const char* program) {
+    printf("Uso: %s [--engine=serial|threads|processes] [-j N] [-L bits] [-b KB] [-a] [-s] [--stats=json]\n"
+           "        <directorio_entrada> <archivo_salida.bin>\n", program);
+    printf("     %s -p [-L bits] [-b KB] [--stats=json] < entrada > salida.huf\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    struct CompressOptions options = {0};
+    enum Engine engine = DEFAULT_ENGINE;
+    int pipeMode = 0; // -p: stdin -> stdout con una tabla por bloque
+    static const struct option longOptions[] = {
+        { "engine", required_argument, NULL, 'E' },
+        { "stats",  required_argument, NULL, 'S' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "L:b:j:asp", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'E':
+            if (parseEngineName(optarg, &engine) != 0) {
+                printf("Error: --engine debe ser serial, threads o processes\n");
+                return 1;
+            }
+            break;
+        case 'L':
+            options.maxLen = atoi(optarg);
+            if (options.maxLen < 1 || options.maxLen > HUFF_MAX_CODE_LEN) {
+                printf("Error: -L debe estar entre 1 y %d\n", HUFF_MAX_CODE_LEN);
+                return 1;
+            }
+            break;
+        case 'b':
+            options.blockSize = atoi(optarg);
+            if (options.blockSize < 1 || options.blockSize > 1024 * 1024) {
+                printf("Error: -b debe estar entre 1 y %d KB\n", 1024 * 1024);
+                return 1;
+            }
+            options.blockSize *= 1024;
+            break;
+        case 'j':
+            options.jobs = atoi(optarg);
+            if (options.jobs < 1 || options.jobs > 1024) {
+                printf("Error: -j debe estar entre 1 y 1024\n");
+                return 1;
+            }
+            break;
+        case 'a':
+            options.adaptive = 1;
+            break;
+        case 's':
+            options.streaming = 1;
+            break;
+        case 'p':
+            pipeMode = 1;
+            break;
+        case 'S':
+            if (parseStatsFormat(optarg) != 0) {
+                printf("Error: --stats solo admite 'json'\n");
+                return 1;
+            }
+            options.statsJson = 1;
+            break;
+        default:
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (engine == ENGINE_SERIAL && options.jobs > 1) {
+        printf("Error: -j solo se aplica con --engine=threads o --engine=processes\n");
+        return 1;
+    }
+    if ((options.streaming || pipeMode) && engine != ENGINE_SERIAL) {
+        printf("Error: -s y -p solo están disponibles con --engine=serial\n");
+        return 1;
+    }
+
+    if (pipeMode) {
+        // stdout lleva los datos: los mensajes van a stderr
+        if (argc != optind) {
+            fprintf(stderr, "Uso: %s -p [-L bits] [-b KB] < entrada > salida.huf\n", argv[0]);
+            return 1;
+        }
+        if (statsInit(&stats, "huffman_compressor", options.statsJson, 0) != 0) {
+            perror("calloc");
+            return 1;
+        }
+        int blockSize = options.blockSize ? options.blockSize : ARCHIVE_DEFAULT_BLOCK_KB * 1024;
+        if (compressPipe(stdin, stdout, blockSize, options.maxLen) != 0) {
+            fprintf(stderr, "Error: No se pudo comprimir la entrada estándar\n");
+            return 1;
+        }
+        statsWriteJson(&stats, stderr);
+        statsFree(&stats);
+        return 0;
+    }
+    if (argc - optind != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    options.inputDir   = argv[optind];
+    options.outputPath = argv[optind + 1];
+
+    switch (engine) {
+    case ENGINE_THREADS:   return compressThreads(&options);
+    case ENGINE_PROCESSES: return compressProcesses(&options);
+    default:               return compressSerial(&options);
+    }
+}
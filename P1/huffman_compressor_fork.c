@@ -1,60 +1,38 @@
+#define _GNU_SOURCE  // memfd_create, fallocate
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
 
-#define MAX_FILES 100
-#define MAX_FILENAME 256
 #define MAX_CHARS 256
-#define MAX_TREE_HT 256
 
 struct FileInfo {
-    char filename[MAX_FILENAME];
-    char* content;
-    int size;
-};
-
-struct FreqMap {
-    char character;
-    int frequency;
-    int used;
-};
-
-struct CodeMap {
-    char character;
-    char code[MAX_TREE_HT];
-    int used;
-};
-
-struct MinHeapNode {
-    char data;
-    int freq;
-    struct MinHeapNode *left, *right;
-};
-
-struct MinHeap {
-    int size;
-    int capacity;
-    struct MinHeapNode** array;
-};
-
-struct EncodedDataHeader {
-    int encodedLen;   // bits totales
-    int byteCount;    // bytes del buffer binario
-    int lastBitCount; // # de bits útiles del último byte (1..8)
+    const char* filename;      // ruta relativa a la raíz (de la FileList)
+    const char* path;
+    const char* content;       // apunta a la proyección de 'input'
+    size_t size;
+    struct MappedFile input;
 };
 
-static struct FreqMap freq[MAX_CHARS];
-static struct CodeMap codes[MAX_CHARS];
-static int freqCount = 0;
-static int codeCount = 0;
+static uint8_t codeLens[HUFF_SYMBOLS];          // longitud del código de cada byte
+static struct HuffCode codeTable[HUFF_SYMBOLS]; // códigos canónicos indexados por byte
+static struct RunStats stats;                   // --stats=json, compartido con los workers
 
-long long elapsedMillis(struct timeval start, struct timeval end)
+static long long elapsedMillis(struct timeval start, struct timeval end)
 {
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
@@ -67,236 +45,37 @@ long long elapsedMillis(struct timeval start, struct timeval end)
     return seconds * 1000LL + microseconds / 1000LL;
 }
 
-static struct MinHeapNode* newNode(char data, int freq)
-{
-    struct MinHeapNode* node = malloc(sizeof(struct MinHeapNode));
-    if (!node) {
-        perror("malloc");
-        return NULL;
-    }
-    node->left = node->right = NULL;
-    node->data = data;
-    node->freq = freq;
-    return node;
-}
-
-static struct MinHeap* createMinHeap(int capacity)
-{
-    struct MinHeap* minHeap = malloc(sizeof(struct MinHeap));
-    if (!minHeap) {
-        perror("malloc");
-        return NULL;
-    }
-    minHeap->size = 0;
-    minHeap->capacity = capacity;
-    minHeap->array = malloc(minHeap->capacity * sizeof(struct MinHeapNode*));
-    if (!minHeap->array) {
-        perror("malloc");
-        free(minHeap);
-        return NULL;
-    }
-    return minHeap;
-}
-
-static void swapMinHeapNode(struct MinHeapNode** a, struct MinHeapNode** b)
-{
-    struct MinHeapNode* t = *a;
-    *a = *b;
-    *b = t;
-}
-
-static void minHeapify(struct MinHeap* minHeap, int idx)
-{
-    int smallest = idx;
-    int left = 2 * idx + 1;
-    int right = 2 * idx + 2;
-
-    if (left < minHeap->size &&
-        minHeap->array[left]->freq < minHeap->array[smallest]->freq)
-        smallest = left;
-
-    if (right < minHeap->size &&
-        minHeap->array[right]->freq < minHeap->array[smallest]->freq)
-        smallest = right;
-
-    if (smallest != idx) {
-        swapMinHeapNode(&minHeap->array[smallest], &minHeap->array[idx]);
-        minHeapify(minHeap, smallest);
-    }
-}
-
-static int isSizeOne(struct MinHeap* minHeap)
-{
-    return (minHeap->size == 1);
-}
-
-static struct MinHeapNode* extractMin(struct MinHeap* minHeap)
-{
-    struct MinHeapNode* temp = minHeap->array[0];
-    minHeap->array[0] = minHeap->array[minHeap->size - 1];
-    --minHeap->size;
-    minHeapify(minHeap, 0);
-    return temp;
-}
-
-static void insertMinHeap(struct MinHeap* minHeap, struct MinHeapNode* minHeapNode)
-{
-    ++minHeap->size;
-    int i = minHeap->size - 1;
-
-    while (i && minHeapNode->freq < minHeap->array[(i - 1) / 2]->freq) {
-        minHeap->array[i] = minHeap->array[(i - 1) / 2];
-        i = (i - 1) / 2;
-    }
-    minHeap->array[i] = minHeapNode;
-}
-
-static void storeCodes(struct MinHeapNode* root, char* str, int depth)
+// Proyecta el archivo en memoria; el worker cuenta y codifica desde ahí
+static const char* readFile(const char* filename, struct MappedFile* input, size_t* size)
 {
-    if (root == NULL) return;
-
-    
-    if (!root->left && !root->right) {
-        str[depth] = '\0';
-        codes[codeCount].character = root->data;
-        strcpy(codes[codeCount].code, str);
-        codes[codeCount].used = 1;
-        codeCount++;
-        return;
-    }
-
-    if (root->left) {
-        str[depth] = '0';
-        storeCodes(root->left, str, depth + 1);
-    }
-    if (root->right) {
-        str[depth] = '1';
-        storeCodes(root->right, str, depth + 1);
-    }
-}
-
-static struct MinHeapNode* buildHuffmanTree()
-{
-    struct MinHeapNode *left, *right, *top;
-    struct MinHeap* minHeap = createMinHeap(freqCount);
-    if (!minHeap) return NULL;
-
-    for (int i = 0; i < freqCount; i++) {
-        if (freq[i].used) {
-            struct MinHeapNode* node = newNode(freq[i].character, freq[i].frequency);
-            if (!node) {
-                free(minHeap->array);
-                free(minHeap);
-                return NULL;
-            }
-            insertMinHeap(minHeap, node);
-        }
-    }
-
-    while (!isSizeOne(minHeap)) {
-        left = extractMin(minHeap);
-        right = extractMin(minHeap);
-
-        top = newNode('\0', left->freq + right->freq);
-        if (!top) {
-            free(minHeap->array);
-            free(minHeap);
-            return NULL;
-        }
-        top->left = left;
-        top->right = right;
-
-        insertMinHeap(minHeap, top);
-    }
-
-    struct MinHeapNode* root = extractMin(minHeap);
-    char str[MAX_TREE_HT];
-    storeCodes(root, str, 0);
-
-    free(minHeap->array);
-    free(minHeap);
-    return root;
+    if (mapFileReadOnly(filename, input, POSIX_MADV_SEQUENTIAL) != 0) return NULL;
+    *size = input->size;
+    return (const char*)input->data;
 }
 
-static void calcFreq(char* str, int len)
+// Recorre el árbol con 'threads' hilos y deja los archivos .txt de mayor a
+// menor tamaño, que es el orden en que los toman los workers (ellos se
+// encargan de leerlos)
+static int listDirectory(const char* dirPath, int threads, struct FileList* list, struct FileInfo** filesOut)
 {
-    for (int i = 0; i < len; i++) {
-        int found = 0;
-        for (int j = 0; j < freqCount; j++) {
-            if (freq[j].used && freq[j].character == str[i]) {
-                freq[j].frequency++;
-                found = 1;
-                break;
-            }
-        }
-        if (!found) {
-            freq[freqCount].character = str[i];
-            freq[freqCount].frequency = 1;
-            freq[freqCount].used = 1;
-            freqCount++;
-        }
-    }
-}
-
-static const char* getCode(char c)
-{
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used && codes[i].character == c) {
-            return codes[i].code;
-        }
-    }
-    return "";
-}
-
-static char* readFile(const char* filename, int* size)
-{
-    FILE* file = fopen(filename, "r");
-    if (!file) return NULL;
-
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char* content = malloc(*size + 1);
-    if (!content) {
-        fclose(file);
-        return NULL;
-    }
-    fread(content, 1, *size, file);
-    content[*size] = '\0';
-
-    fclose(file);
-    return content;
-}
-
-static int readDirectory(const char* dirPath, struct FileInfo* files)
-{
-    DIR* dir = opendir(dirPath);
-    if (!dir) {
+    *filesOut = NULL;
+    if (walkDirectory(dirPath, threads, list) != 0) {
         printf("Error: No se pudo abrir el directorio %s\n", dirPath);
         return 0;
     }
+    sortLargestFirst(list);
 
-    struct dirent* entry;
-    int fileCount = 0;
-    char fullPath[512];
-
-    while ((entry = readdir(dir)) != NULL && fileCount < MAX_FILES) {
-        if (strstr(entry->d_name, ".txt") != NULL) {
-            sprintf(fullPath, "%s/%s", dirPath, entry->d_name);
-
-            strcpy(files[fileCount].filename, entry->d_name);
-            files[fileCount].content = readFile(fullPath, &files[fileCount].size);
-
-            if (files[fileCount].content != NULL) {
-                printf("Archivo leído: %s (%d bytes)\n", entry->d_name, files[fileCount].size);
-                fileCount++;
-            }
-        }
+    struct FileInfo* files = calloc((size_t)(list->count > 0 ? list->count : 1), sizeof(struct FileInfo));
+    if (!files) {
+        perror("calloc");
+        return 0;
     }
-
-    closedir(dir);
-    return fileCount;
+    for (int i = 0; i < list->count; i++) {
+        files[i].filename = list->entries[i].name;
+        files[i].path = list->entries[i].path;
+    }
+    *filesOut = files;
+    return list->count;
 }
 
 static ssize_t writeFull(int fd, const void* buffer, size_t count)
@@ -334,242 +113,496 @@ static ssize_t readFull(int fd, void* buffer, size_t count)
     return (ssize_t)total;
 }
 
-static int encodeFileContent(const struct FileInfo* file, char** encodedContent, int* encodedLen)
+// ---------------- Pool de procesos ---------------------
+// Memoria compartida (MAP_SHARED) entre el padre y los workers. Tras la
+// estructura van los histogramas y después 'fileSize' y 'readOk', una entrada
+// por archivo; el padre fija los punteros antes del fork y los workers los
+// heredan apuntando a la misma proyección.
+struct SharedState {
+    int nextFile;                  // contador atómico de archivos por leer
+    int* readOk;                   // 1 si el worker pudo leer el archivo
+    uint64_t* fileSize;
+    uint8_t codeLens[HUFF_SYMBOLS]; // longitudes decididas por el padre
+    uint64_t hist[];               // un histograma de MAX_CHARS por worker
+};
+
+#define PHASE_DONE (-1)  // aviso del worker: terminó de leer y contar
+
+// Cada worker deja sus resultados en su propio memfd (arena) y solo envía por
+// el pipe este descriptor. En la arena, a partir de 'offset', hay
+// blockCount pares uint64_t (bits de datos, bytes con la cabecera) de cada
+// bloque seguidos de 'dataBytes' bytes con los bloques empaquetados.
+// blockCount < 0 indica error.
+struct ResultDescriptor {
+    int fileIndex;
+    int blockCount;
+    long long offset;     // múltiplo del tamaño de página
+    long long dataBytes;
+};
+
+static size_t pageAlign(size_t n)
 {
-    int bufferSize = file->size > 0 ? file->size * 20 : 1;
-    char* buffer = malloc(bufferSize);
-    if (!buffer) {
-        perror("malloc");
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (n + page - 1) / page * page;
+}
+
+// Worker: codifica el archivo directamente en la arena compartida a partir de
+// 'offset' y devuelve el descriptor. La región se reserva con la cota de
+// blockEncodedBound; el memfd es disperso, así que solo ocupan memoria los
+// bytes que realmente se escriben.
+static int encodeIntoArena(int arenaFd, size_t offset, const struct FileInfo* file, int fileIndex,
+                           int blockSize, const struct BlockCoder* coder, int maxLen,
+                           struct ResultDescriptor* desc)
+{
+    size_t size = file->size;
+    int blockCount = blockCountFor(size, blockSize);
+    size_t step = blockSize > 0 ? (size_t)blockSize : size;
+
+    size_t indexBytes = (size_t)blockCount * 2 * sizeof(uint64_t);
+    size_t reserve = indexBytes;
+    for (int b = 0; b < blockCount; b++) {
+        size_t start = (size_t)b * step;
+        reserve += blockEncodedBound(size - start < step ? size - start : step, maxLen);
+    }
+    if (reserve == 0) reserve = 1;
+
+    if (ftruncate(arenaFd, (off_t)(offset + reserve)) != 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    unsigned char* region = mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_SHARED, arenaFd, (off_t)offset);
+    if (region == MAP_FAILED) {
+        perror("mmap");
         return -1;
     }
 
-    int position = 0;
-    for (int j = 0; j < file->size; j++) {
-        const char* code = getCode(file->content[j]);
-        if (code[0] == '\0') {
-            fprintf(stderr, "Error: Código no encontrado para caracter %c\n", file->content[j]);
-            free(buffer);
+    uint64_t* index = (uint64_t*)region;
+    size_t used = 0;
+    for (int b = 0; b < blockCount; b++) {
+        size_t start = (size_t)b * step;
+        size_t len = size - start < step ? size - start : step;
+        struct EncodedBlock blk;
+        uint64_t t0 = monotonicNs();
+        if (encodeBlockInto(coder, (const unsigned char*)file->content + start, len,
+                            region + indexBytes + used, blockEncodedBound(len, maxLen), &blk) != 0) {
+            fprintf(stderr, "Error: Código no encontrado al codificar %s\n", file->filename);
+            munmap(region, reserve);
             return -1;
         }
-        int len = strlen(code);
-        if (position + len + 1 >= bufferSize) {
-            bufferSize *= 2;
-            char* newBuffer = realloc(buffer, bufferSize);
-            if (!newBuffer) {
-                perror("realloc");
-                free(buffer);
-                return -1;
-            }
-            buffer = newBuffer;
-        }
-        memcpy(buffer + position, code, len);
-        position += len;
+        statsPhase(&stats, STAT_ENCODE, t0, len, blk.bytes);
+        index[2 * b]     = blk.bits;
+        index[2 * b + 1] = blk.bytes;
+        used += blk.bytes;
     }
+    munmap(region, reserve);
 
-    buffer[position] = '\0';
-    *encodedContent = buffer;
-    *encodedLen = position;
+    desc->fileIndex  = fileIndex;
+    desc->blockCount = blockCount;
+    desc->offset     = (long long)offset;
+    desc->dataBytes  = (long long)used;
     return 0;
 }
 
-static int convertEncodedToBuffer(const char* encodedContent, int encodedLen,
-                                  unsigned char** binaryBuffer, int* byteCount,
-                                  int* lastBitCount)
+// Cuerpo de cada worker. Fase 1: toma archivos del contador compartido, los
+// lee y cuenta sus bytes. Fase 2 (cuando el padre publica las longitudes):
+// codifica los archivos que leyó en su arena y avisa por su pipe.
+static void runWorker(struct SharedState* shared, int worker,
+                      struct FileInfo* files, int fileCount, int blockSize,
+                      const struct BlockCoder* coder, int resultFd, int controlFd, int arenaFd)
 {
-    *byteCount = (encodedLen + 7) / 8;
-    int bitsInLastByte = (encodedLen % 8 == 0) ? 8 : (encodedLen % 8);
-    if (encodedLen == 0) bitsInLastByte = 8;
-
-    unsigned char* buffer = NULL;
-    if (*byteCount > 0) {
-        buffer = calloc((size_t)(*byteCount), sizeof(unsigned char));
-        if (!buffer) {
-            perror("calloc");
-            return -1;
-        }
+    uint64_t* hist = shared->hist + (size_t)worker * MAX_CHARS;
+    int* mine = malloc(sizeof(int) * (size_t)fileCount);
+    int mineCount = 0;
+
+    for (;;) {
+        int i = __atomic_fetch_add(&shared->nextFile, 1, __ATOMIC_RELAXED);
+        if (i >= fileCount) break;
+
+        uint64_t t0 = monotonicNs();
+        files[i].content = readFile(files[i].path, &files[i].input, &files[i].size);
+        if (!files[i].content) continue;
+        statsPhase(&stats, STAT_READ, t0, files[i].size, 0);
+
+        t0 = monotonicNs();
+        countBytes((const unsigned char*)files[i].content, files[i].size, hist);
+        statsPhase(&stats, STAT_HISTOGRAM, t0, files[i].size, 0);
+        shared->fileSize[i] = files[i].size;
+        shared->readOk[i] = 1;
+        if (mine) mine[mineCount++] = i;
     }
 
-    unsigned char currentByte = 0;
-    int bitIndex = 0;
-    int bufferIndex = 0;
+    int marker = PHASE_DONE;
+    writeFull(resultFd, &marker, sizeof(marker));
+
+    // Esperar la orden del padre: 1 = codificar, 0 (o EOF) = abortar
+    char go = 0;
+    if (!mine || readFull(controlFd, &go, 1) != 1 || go != 1) _exit(mine ? 0 : 1);
+
+    memcpy(codeLens, shared->codeLens, sizeof(codeLens));
+    if (assignCanonicalCodes(codeLens, codeTable) != 0) _exit(1);
+    int maxLen = 0;
+    for (int c = 0; c < HUFF_SYMBOLS; c++)
+        if (codeLens[c] > maxLen) maxLen = codeLens[c];
+
+    size_t arenaEnd = 0;
+    for (int k = 0; k < mineCount; k++) {
+        int i = mine[k];
+        struct ResultDescriptor desc;
+        uint64_t t0 = monotonicNs();
+        if (encodeIntoArena(arenaFd, arenaEnd, &files[i], i, blockSize, coder, maxLen, &desc) != 0) {
+            desc.fileIndex = i;
+            desc.blockCount = -1;
+            writeFull(resultFd, &desc, sizeof(desc));
+            _exit(1);
+        }
+        statsFile(&stats, i, files[i].size, 0, monotonicNs() - t0);
+        unmapFile(&files[i].input);
+        files[i].content = NULL;
 
-    for (int i = 0; i < encodedLen; i++) {
-        currentByte = (currentByte << 1) | (encodedContent[i] - '0');
-        bitIndex++;
+        arenaEnd = pageAlign(arenaEnd + (size_t)desc.blockCount * 2 * sizeof(uint64_t) + (size_t)desc.dataBytes);
+        if (writeFull(resultFd, &desc, sizeof(desc)) != sizeof(desc)) _exit(1);
+    }
 
-        if (bitIndex == 8) {
-            buffer[bufferIndex++] = currentByte;
-            currentByte = 0;
-            bitIndex = 0;
+    free(mine);
+    _exit(0);
+}
+
+// Padre: escribe el registro leyendo los bloques directamente de la arena
+// del worker y después devuelve esas páginas al sistema
+static int writeFromArena(FILE* outFile, struct ArchiveToc* toc, int arenaFd,
+                          const struct ResultDescriptor* desc, const char* filename,
+                          uint64_t originalSize, int blockSize)
+{
+    size_t indexBytes = (size_t)desc->blockCount * 2 * sizeof(uint64_t);
+    size_t length = indexBytes + (size_t)desc->dataBytes;
+    unsigned char* region = NULL;
+    if (length > 0) {
+        region = mmap(NULL, length, PROT_READ, MAP_SHARED, arenaFd, (off_t)desc->offset);
+        if (region == MAP_FAILED) {
+            perror("mmap");
+            return -1;
         }
     }
 
-    if (bitIndex > 0 && buffer) {
-        currentByte <<= (8 - bitIndex);
-        buffer[bufferIndex++] = currentByte;
+    struct EncodedBlock* blocks = calloc((size_t)(desc->blockCount > 0 ? desc->blockCount : 1),
+                                         sizeof(struct EncodedBlock));
+    int rc = -1;
+    if (blocks) {
+        const uint64_t* index = (const uint64_t*)region;
+        size_t at = indexBytes;
+        rc = 0;
+        for (int b = 0; b < desc->blockCount; b++) {
+            blocks[b].bits  = index[2 * b];
+            blocks[b].bytes = (size_t)index[2 * b + 1];
+            blocks[b].data  = region + at;
+            at += blocks[b].bytes;
+        }
+        if (at != length) rc = -1;
+        if (rc == 0) rc = writeFileRecord(outFile, toc, filename, originalSize, blockSize, blocks, desc->blockCount);
+        free(blocks);
     }
 
-    *binaryBuffer = buffer;
-    *lastBitCount = bitsInLastByte;
-    return 0;
+    if (region) munmap(region, length);
+    // Sin agujeros la arena conserva todo lo codificado hasta el final; el
+    // worker puede seguir escribiendo detrás, así que no se recorta con
+    // ftruncate: solo se avisa (una vez) de que la memoria ya no está acotada
+    static int punchWarned = 0;
+    if (length > 0 &&
+        fallocate(arenaFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)desc->offset, (off_t)length) != 0 &&
+        !punchWarned) {
+        perror("fallocate (las arenas no liberan memoria hasta terminar)");
+        punchWarned = 1;
+    }
+    return rc;
 }
-int main(int argc, char* argv[])
+
+// Motor 'processes' (--engine=processes): fase 1 en workers creados con
+// fork(), que leen y cuentan; el padre decide los códigos y los workers
+// codifican en sus arenas.
+int compressProcesses(const struct CompressOptions* options)
 {
-    if (argc != 3) {
-        printf("Uso: %s <directorio_entrada> <archivo_salida.bin>\n", argv[0]);
+    int maxLenLimit = options->maxLen;
+    int blockSize = options->blockSize;
+    int workerCount = engineJobs(options->jobs);
+    // Los contadores van en memoria compartida para que los workers sumen en ellos
+    if (statsInit(&stats, "huffman_compressor_fork", options->statsJson, 1) != 0) {
+        perror("mmap");
         return 1;
     }
+    const char* inputDir   = options->inputDir;
+    const char* outputPath = options->outputPath;
 
     struct timeval startTime, endTime;
     gettimeofday(&startTime, NULL);
 
-    struct FileInfo files[MAX_FILES];
-    long totalSize = 0;
+    uint64_t totalSize = 0;
 
-    memset(freq, 0, sizeof(freq));
-    memset(codes, 0, sizeof(codes));
-    freqCount = 0;
-    codeCount = 0;
+    memset(codeLens, 0, sizeof(codeLens));
+    memset(codeTable, 0, sizeof(codeTable));
 
-    int fileCount = readDirectory(argv[1], files);
+    // El recorrido usa tantos hilos como workers habrá después
+    struct FileList list;
+    struct FileInfo* files;
+    uint64_t t0 = monotonicNs();
+    int fileCount = listDirectory(inputDir, workerCount, &list, &files);
+    statsPhase(&stats, STAT_SCAN, t0, 0, 0);
     if (fileCount == 0) {
         printf("No se encontraron archivos .txt en el directorio\n");
         return 1;
     }
-
-    for (int i = 0; i < fileCount; i++) {
-        calcFreq(files[i].content, files[i].size);
-        totalSize += files[i].size;
-    }
-
-    printf("\nCalculando frecuencias de %ld caracteres...\n", totalSize);
-
-    printf("Construyendo árbol de Huffman...\n");
-    struct MinHeapNode* root = buildHuffmanTree();
-    if (!root) {
-        fprintf(stderr, "Error construyendo el árbol de Huffman\n");
+    if (statsInitFiles(&stats, fileCount) != 0) {
+        perror("mmap");
         return 1;
     }
-
-    FILE* outFile = fopen(argv[2], "wb");
-    if (!outFile) {
-        printf("Error: No se pudo crear el archivo de salida\n");
+    for (int i = 0; i < stats.fileCount; i++) stats.files[i].name = files[i].filename;
+    if (workerCount > fileCount) workerCount = fileCount;
+
+    size_t histBytes = (size_t)workerCount * MAX_CHARS * sizeof(uint64_t);
+    size_t sharedBytes = sizeof(struct SharedState) + histBytes +
+                         (size_t)fileCount * (sizeof(uint64_t) + sizeof(int));
+    struct SharedState* shared = mmap(NULL, sharedBytes, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
         return 1;
     }
-
-    fwrite(&fileCount, sizeof(int), 1, outFile);
-    fwrite(&codeCount, sizeof(int), 1, outFile);
-
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used) {
-            fwrite(&codes[i].character, sizeof(char), 1, outFile);
-            int codeLen = strlen(codes[i].code);
-            fwrite(&codeLen, sizeof(int), 1, outFile);
-            fwrite(codes[i].code, sizeof(char), codeLen, outFile);
-        }
-    }
-
-    // Procesar cada archivo con un hijo
-    for (int i = 0; i < fileCount; i++) {
-        int pipefd[2];
-        if (pipe(pipefd) == -1) {
+    memset(shared, 0, sharedBytes);
+    shared->fileSize = (uint64_t*)((unsigned char*)shared->hist + histBytes);
+    shared->readOk = (int*)(shared->fileSize + fileCount);
+
+    // Los workers codifican con las longitudes que el padre publica en
+    // 'shared' y que copian a su codeLens antes de la fase 2
+    struct BlockCoder coder = { codeLens, codeTable, maxLenLimit, options->adaptive };
+
+    // Lanzar los workers: cada uno con su arena (memfd), un pipe de
+    // descriptores de resultado y otro de control
+    pid_t pids[workerCount];
+    int resultFd[workerCount];
+    int controlFd[workerCount];
+    int arenaFd[workerCount];
+    fflush(stdout);
+    for (int w = 0; w < workerCount; w++) {
+        int res[2], ctl[2];
+        if (pipe(res) == -1 || pipe(ctl) == -1) {
             perror("pipe");
-            fclose(outFile);
+            return 1;
+        }
+        arenaFd[w] = memfd_create("huffman-arena", 0);
+        if (arenaFd[w] == -1) {
+            perror("memfd_create");
             return 1;
         }
 
         pid_t pid = fork();
         if (pid == -1) {
             perror("fork");
-            close(pipefd[0]);
-            close(pipefd[1]);
-            fclose(outFile);
             return 1;
         }
-
         if (pid == 0) {
-            close(pipefd[0]);
-
-            char* encodedContent = NULL;
-            int encodedLen = 0;
-            if (encodeFileContent(&files[i], &encodedContent, &encodedLen) != 0) {
-                close(pipefd[1]);
-                _exit(1);
+            close(res[0]);
+            close(ctl[1]);
+            // Cerrar los extremos heredados de los workers anteriores
+            for (int k = 0; k < w; k++) {
+                close(resultFd[k]);
+                close(controlFd[k]);
+                close(arenaFd[k]);
             }
+            runWorker(shared, w, files, fileCount, blockSize, &coder, res[1], ctl[0], arenaFd[w]);
+        }
+        close(res[1]);
+        close(ctl[0]);
+        pids[w] = pid;
+        resultFd[w] = res[0];
+        controlFd[w] = ctl[1];
+    }
 
-            unsigned char* binaryBuffer = NULL;
-            int byteCount = 0;
-            int lastBitCount = 8;
-            if (convertEncodedToBuffer(encodedContent, encodedLen, &binaryBuffer,
-                                        &byteCount, &lastBitCount) != 0) {
-                free(encodedContent);
-                close(pipefd[1]);
-                _exit(1);
-            }
+    // Fase 1: esperar a que todos los workers terminen de contar
+    int status = 0;
+    for (int w = 0; w < workerCount; w++) {
+        int marker = 0;
+        if (readFull(resultFd[w], &marker, sizeof(marker)) != sizeof(marker) || marker != PHASE_DONE) {
+            fprintf(stderr, "Error: el worker %d terminó antes de tiempo\n", pids[w]);
+            status = 1;
+        }
+    }
 
-            struct EncodedDataHeader header = { encodedLen, byteCount, lastBitCount };
-            writeFull(pipefd[1], &header, sizeof(header));
-
-            if (byteCount > 0)
-                writeFull(pipefd[1], binaryBuffer, (size_t)byteCount);
-
-            free(binaryBuffer);
-            free(encodedContent);
-            close(pipefd[1]);
-            _exit(0);
-        } else { 
-            close(pipefd[1]);
-
-            int nameLen = strlen(files[i].filename);
-            fwrite(&nameLen, sizeof(int), 1, outFile);
-            fwrite(files[i].filename, sizeof(char), nameLen, outFile);
-
-            struct EncodedDataHeader header;
-            if (readFull(pipefd[0], &header, sizeof(header)) != sizeof(header)) {
-                fprintf(stderr, "Error leyendo datos codificados del hijo\n");
-                close(pipefd[0]);
-                fclose(outFile);
-                return 1;
-            }
+    int archiveCount = 0;
+    uint64_t symFreq[HUFF_SYMBOLS] = {0};
+    for (int i = 0; i < fileCount; i++) {
+        if (!shared->readOk[i]) continue;
+        files[i].size = (size_t)shared->fileSize[i];
+        printf("Archivo leído: %s (%zu bytes)\n", files[i].filename, files[i].size);
+        totalSize += files[i].size;
+        archiveCount++;
+    }
+    for (int w = 0; w < workerCount; w++)
+        for (int c = 0; c < MAX_CHARS; c++)
+            symFreq[c] += shared->hist[(size_t)w * MAX_CHARS + c];
+
+    if (status == 0 && archiveCount == 0) {
+        printf("No se encontraron archivos .txt en el directorio\n");
+        status = 1;
+    }
+
+    uint64_t treeStart = monotonicNs();
+    if (status == 0) {
+        printf("\nCalculando frecuencias de %llu caracteres...\n", (unsigned long long)totalSize);
+
+        printf("Construyendo árbol de Huffman...\n");
+
+        // Longitudes óptimas, limitadas a -L (o a 64 bits como máximo)
+        uint64_t optimalBits = 0, limitedBits = 0;
+        int limited = buildCodeLengths(symFreq, maxLenLimit, codeLens, &optimalBits, &limitedBits);
+        if (limited < 0) {
+            printf("Error: %d bits no alcanzan para %d símbolos\n", maxLenLimit, symbolCount(symFreq));
+            status = 1;
+        } else if (limited > 0) {
+            printf("Códigos limitados a %d bits: %llu -> %llu bits (+%.3f%%)\n",
+                   maxLenLimit > 0 ? maxLenLimit : HUFF_MAX_CODE_LEN,
+                   (unsigned long long)optimalBits, (unsigned long long)limitedBits,
+                   optimalBits ? 100.0 * (double)(limitedBits - optimalBits) / (double)optimalBits : 0.0);
+        }
+    }
+
+    if (status == 0 && assignCanonicalCodes(codeLens, codeTable) != 0) {
+        fprintf(stderr, "Error: algún código supera %d bits\n", HUFF_MAX_CODE_LEN);
+        status = 1;
+    }
+    if (status == 0) statsPhase(&stats, STAT_TREE, treeStart, 0, 0);
+
+    FILE* outFile = NULL;
+    if (status == 0) {
+        outFile = fopen(outputPath, "wb");
+        t0 = monotonicNs();
+        if (!outFile) {
+            printf("Error: No se pudo crear el archivo de salida\n");
+            status = 1;
+        } else if (writeArchiveHeader(outFile, archiveCount, blockSize, codeLens) != 0) {
+            perror("fwrite cabecera");
+            status = 1;
+        } else {
+            statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)ftello(outFile));
+        }
+    }
+
+    // Estado de la fase 2, una entrada por archivo
+    struct ResultDescriptor* results = malloc((size_t)fileCount * sizeof(struct ResultDescriptor));
+    int* received = calloc((size_t)fileCount, sizeof(int));
+    int* workerOf = malloc((size_t)fileCount * sizeof(int));
+    if (!results || !received || !workerOf) {
+        perror("malloc");
+        status = 1;
+    }
 
+    // Publicar las longitudes y dar la orden de codificar (o de abortar)
+    memcpy(shared->codeLens, codeLens, sizeof(codeLens));
+    char go = status == 0 ? 1 : 0;
+    for (int w = 0; w < workerCount; w++) {
+        writeFull(controlFd[w], &go, 1);
+        close(controlFd[w]);
+    }
 
-            fwrite(&header.encodedLen, sizeof(int), 1, outFile);
-
-            if (header.byteCount > 0) {
-                unsigned char* buffer = malloc((size_t)header.byteCount);
-                if (!buffer) {
-                    perror("malloc");
-                    close(pipefd[0]);
-                    fclose(outFile);
-                    return 1;
-                }
-                if (readFull(pipefd[0], buffer, (size_t)header.byteCount) != header.byteCount) {
-                    fprintf(stderr, "Error leyendo datos binarios del hijo\n");
-                    free(buffer);
-                    close(pipefd[0]);
-                    fclose(outFile);
-                    return 1;
-                }
-                fwrite(buffer, 1, (size_t)header.byteCount, outFile);
-                free(buffer);
+    // Fase 2: recibir descriptores en cualquier orden y escribir en el del archivo
+    int nextToWrite = 0;
+    struct ArchiveToc toc = {0};
+    int openWorkers = status == 0 ? workerCount : 0;
+
+    struct pollfd fds[workerCount];
+    for (int w = 0; w < workerCount; w++) {
+        fds[w].fd = status == 0 ? resultFd[w] : -1;
+        fds[w].events = POLLIN;
+    }
+
+    while (openWorkers > 0 && status == 0) {
+        if (poll(fds, (nfds_t)workerCount, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            status = 1;
+            break;
+        }
+        for (int w = 0; w < workerCount && status == 0; w++) {
+            if (fds[w].fd < 0 || !(fds[w].revents & (POLLIN | POLLHUP))) continue;
+
+            struct ResultDescriptor desc;
+            ssize_t n = readFull(fds[w].fd, &desc, sizeof(desc));
+            if (n == 0) {
+                fds[w].fd = -1;
+                openWorkers--;
+                continue;
+            }
+            int i = desc.fileIndex;
+            if (n != sizeof(desc) || desc.blockCount < 0 || i < 0 || i >= fileCount || received[i]) {
+                fprintf(stderr, "Error leyendo datos codificados del worker %d\n", pids[w]);
+                status = 1;
+                break;
             }
+            results[i] = desc;
+            received[i] = 1;
+            workerOf[i] = w;
+        }
 
-            fwrite(&header.lastBitCount, sizeof(int), 1, outFile);
+        // Escribir todos los archivos consecutivos que ya están listos
+        while (status == 0 && nextToWrite < fileCount &&
+               (!shared->readOk[nextToWrite] || received[nextToWrite])) {
+            int i = nextToWrite++;
+            if (!shared->readOk[i]) continue;
+
+            off_t recordStart = ftello(outFile);
+            t0 = monotonicNs();
+            if (writeFromArena(outFile, &toc, arenaFd[workerOf[i]], &results[i], files[i].filename,
+                               (uint64_t)files[i].size, blockSize) != 0) {
+                perror("fwrite");
+                status = 1;
+                break;
+            }
+            uint64_t recordBytes = (uint64_t)(ftello(outFile) - recordStart);
+            statsPhase(&stats, STAT_WRITE, t0, 0, recordBytes);
+            statsFile(&stats, i, 0, recordBytes, monotonicNs() - t0);
+            printf("Archivo %s codificado mediante PID %d (%d bloques)\n",
+                   files[i].filename, pids[workerOf[i]], results[i].blockCount);
+        }
+    }
 
-            close(pipefd[0]);
-            waitpid(pid, NULL, 0);
+    if (status == 0 && nextToWrite < fileCount) {
+        fprintf(stderr, "Error: faltan archivos codificados por los workers\n");
+        status = 1;
+    }
 
-            printf("Archivo %s codificado mediante PID %d\n", files[i].filename, pid);
-            free(files[i].content);
+    // Índice al final para extraer archivos sueltos
+    off_t tocStart = outFile ? ftello(outFile) : 0;
+    t0 = monotonicNs();
+    if (status == 0 && writeArchiveToc(outFile, &toc) != 0) {
+        perror("fwrite índice");
+        status = 1;
+    }
+    if (status == 0) statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)(ftello(outFile) - tocStart));
+    freeArchiveToc(&toc);
+
+    for (int w = 0; w < workerCount; w++) {
+        close(resultFd[w]);
+        int wstatus = 0;
+        if (waitpid(pids[w], &wstatus, 0) == -1 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+            if (status == 0) fprintf(stderr, "Error: el worker %d terminó con error\n", pids[w]);
+            status = 1;
         }
+        close(arenaFd[w]);
     }
+    munmap(shared, sharedBytes);
+    free(results);
+    free(received);
+    free(workerOf);
+    free(files);
+    freeFileList(&list);
 
-    fclose(outFile);
+    if (outFile) fclose(outFile);
+    if (status != 0) return 1;
 
-    printf("\nCompresión completada: %s\n", argv[2]);
+    printf("\nCompresión completada: %s\n", outputPath);
     gettimeofday(&endTime, NULL);
     long long totalMs = elapsedMillis(startTime, endTime);
     printf("Tiempo total de compresión: %lld ms\n", totalMs);
 
+    statsWriteJson(&stats, stderr);
+    statsFree(&stats);
     return 0;
 }
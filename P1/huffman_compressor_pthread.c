@@ -1,73 +1,66 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <unistd.h>
 
-#define MAX_FILES 100
-#define MAX_FILENAME 256
-#define MAX_CHARS 256
-#define MAX_TREE_HT 256
-
-// -----------------------------------------------------
-// *** DEFINICION DE PTHREADS ***
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
 
-pthread_mutex_t freq_mutex; // Mutex para proteger acceso al mapa de frecuencias
-
-struct ThreadDataCompressor {
-    char filepath[MAX_FILENAME];
-};
+#define MAX_CHARS 256
 
-// ------------------------------------------------------
 
 // Estructura para almacenar información de archivos
 struct FileInfo {
-    char filename[MAX_FILENAME];
-    char *content;
-    int size;
-};
-
-// Estructura para almacenar frecuencias de caracteres
-struct FreqMap {
-    char character;
-    int frequency;
-    int used;
+    const char *filename;      // ruta relativa a la raíz (de la FileList)
+    const char *path;
+    const char *content;       // apunta a la proyección de 'input'
+    size_t size;
+    struct MappedFile input;
+    // Resultado de la codificación
+    struct EncodedBlock *blocks;
+    int blockCount;
+    int pending;      // bloques aún sin codificar
+    int done;         // listo para escribirse en el archivo
+    int failed;
 };
 
-// Estructura para almacenar códigos de caracteres
-struct CodeMap {
-    char character;
-    char code[MAX_TREE_HT];
-    int used;
-};
-
-// Nodo del árbol de Huffman
-struct MinHeapNode {
-    char data;
-    int freq;
-    struct MinHeapNode *left, *right;
-};
-
-// Estructura del heap mínimo
-struct MinHeap {
-    int size;
-    int capacity;
-    struct MinHeapNode **array;
+// Pool fijo de hilos: primero leen archivos y cuentan frecuencias, después
+// codifican bloques (archivo, bloque) tomados de una cola compartida
+struct CompressPool {
+    struct FileInfo *files;
+    int fileCount;
+    int next_file;    // fase 1: siguiente archivo sin leer (atómico)
+    uint64_t (*hist)[MAX_CHARS]; // fase 1: un histograma por hilo, sin locks
+
+    int blockSize;
+    struct BlockCoder coder; // fase 2: tabla global y si cada bloque puede llevar la suya
+    int *unit_file;   // fase 2: archivo y bloque de cada unidad
+    int *unit_block;
+    int unit_count;
+    int next_unit;
+    int abort;        // la construcción de códigos falló: no codificar
+
+    pthread_mutex_t lock;
+    pthread_cond_t file_done;
+    pthread_barrier_t phase;  // sincroniza el cambio de fase con main
 };
 
 // Variables globales
-struct FreqMap freq[MAX_CHARS];
-struct CodeMap codes[MAX_CHARS];
-int freqCount = 0;
-int codeCount = 0;
+static uint8_t codeLens[HUFF_SYMBOLS];          // longitud del código de cada byte
+static struct HuffCode codeTable[HUFF_SYMBOLS]; // códigos canónicos indexados por valor de byte
+static struct RunStats stats;                   // --stats=json (contadores atómicos)
 
-char *readFile(const char *filename, int *size);
-void calcFreq(char *str, int len);
+static const char *readFile(const char *filename, struct MappedFile *input, size_t *size);
 
 // Función para calcular el tiempo transcurrido en milisegundos
-long long elapsedMillis(struct timeval start, struct timeval end) {
+static long long elapsedMillis(struct timeval start, struct timeval end) {
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
     if (microseconds < 0) {
@@ -78,357 +71,381 @@ long long elapsedMillis(struct timeval start, struct timeval end) {
 }
 
 // ---------------------------------------------------------------------------------------
-// Funcion que ejecutara cada hilo para leer un archivo y calcular frecuencias
-void *process_file_compress(void *arg) {
-    struct ThreadDataCompressor *data = (struct ThreadDataCompressor *)arg;
-    int size;
-    char *content = readFile(data->filepath, &size);
-
-    if (content) {
-        // --- Paso 1: calcular frecuencias locales ---
-        int localFreq[MAX_CHARS] = {0};
-        for (int i = 0; i < size; i++) {
-            unsigned char c = (unsigned char)content[i];
-            localFreq[c]++;
-        }
+// Identidad de cada hilo del pool: su índice elige su histograma
+struct PoolThread {
+    struct CompressPool *pool;
+    int index;
+};
 
-        // --- Paso 2: reducir al arreglo global ---
-        pthread_mutex_lock(&freq_mutex);
-        for (int i = 0; i < MAX_CHARS; i++) {
-            if (localFreq[i] > 0) {
-                int found = 0;
-                for (int j = 0; j < freqCount; j++) {
-                    if (freq[j].used && freq[j].character == (char)i) {
-                        freq[j].frequency += localFreq[i];
-                        found = 1;
-                        break;
-                    }
-                }
-                if (!found) {
-                    freq[freqCount].character = (char)i;
-                    freq[freqCount].frequency = localFreq[i];
-                    freq[freqCount].used = 1;
-                    freqCount++;
-                }
-            }
+// Fase 1: leer archivos de la cola y acumular sus frecuencias. Cada archivo
+// se proyecta una sola vez y la fase 2 codifica desde la misma proyección.
+static void read_and_count(struct CompressPool *pool, int index) {
+    uint64_t localFreq[MAX_CHARS] = {0};
+
+    for (;;) {
+        int i = __atomic_fetch_add(&pool->next_file, 1, __ATOMIC_RELAXED);
+        if (i >= pool->fileCount) break;
+
+        struct FileInfo *file = &pool->files[i];
+        uint64_t t0 = monotonicNs();
+        file->content = readFile(file->path, &file->input, &file->size);
+        if (!file->content) {
+            file->failed = 1;
+            continue;
         }
-        pthread_mutex_unlock(&freq_mutex);
+        statsPhase(&stats, STAT_READ, t0, file->size, 0);
 
-        free(content);
+        t0 = monotonicNs();
+        countBytes((const unsigned char *)file->content, file->size, localFreq);
+        statsPhase(&stats, STAT_HISTOGRAM, t0, file->size, 0);
     }
-    free(data);
-    return NULL;
-}
-// ----------------------------------------------------------------------------------------
-
-// Funciones del heap y árbol de Huffman
-struct MinHeapNode *newNode(char data, int freq) {
-    struct MinHeapNode *node = malloc(sizeof(struct MinHeapNode));
-    node->left = node->right = NULL;
-    node->data = data;
-    node->freq = freq;
-    return node;
-}
 
-struct MinHeap *createMinHeap(int capacity) {
-    struct MinHeap *minHeap = malloc(sizeof(struct MinHeap));
-    minHeap->size = 0;
-    minHeap->capacity = capacity;
-    minHeap->array = malloc(minHeap->capacity * sizeof(struct MinHeapNode *));
-    return minHeap;
+    // Sin locks: cada hilo deja su histograma en su hueco y main los suma
+    // después de la barrera
+    memcpy(pool->hist[index], localFreq, sizeof(localFreq));
 }
 
-void swapMinHeapNode(struct MinHeapNode **a, struct MinHeapNode **b) {
-    struct MinHeapNode *t = *a;
-    *a = *b;
-    *b = t;
+// Fase 2: codificar bloques; el hilo que termina el último bloque de un
+// archivo lo marca como listo para que main lo escriba en orden
+static void encode_blocks(struct CompressPool *pool) {
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int unit = pool->next_unit++;
+        pthread_mutex_unlock(&pool->lock);
+        if (unit >= pool->unit_count) break;
+
+        struct FileInfo *file = &pool->files[pool->unit_file[unit]];
+        int b = pool->unit_block[unit];
+        size_t size = file->size;
+        size_t step = pool->blockSize > 0 ? (size_t)pool->blockSize : size;
+        size_t start = (size_t)b * step;
+        size_t len = size - start > step ? step : size - start;
+        uint64_t t0 = monotonicNs();
+        int rc = encodeBlock(&pool->coder, (const unsigned char *)file->content + start, len,
+                             &file->blocks[b]);
+        statsPhase(&stats, STAT_ENCODE, t0, len, file->blocks[b].bytes);
+        statsFile(&stats, pool->unit_file[unit], len, 0, monotonicNs() - t0);
+
+        pthread_mutex_lock(&pool->lock);
+        if (rc != 0) file->failed = 1;
+        if (--file->pending == 0) {
+            file->done = 1;
+            pthread_cond_broadcast(&pool->file_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
 }
 
-void minHeapify(struct MinHeap *minHeap, int idx) {
-    int smallest = idx;
-    int left = 2 * idx + 1;
-    int right = 2 * idx + 2;
-
-    if (left < minHeap->size && minHeap->array[left]->freq < minHeap->array[smallest]->freq)
-        smallest = left;
+// Funcion que ejecuta cada hilo del pool durante ambas fases
+static void *pool_worker(void *arg) {
+    struct PoolThread *self = (struct PoolThread *)arg;
+    struct CompressPool *pool = self->pool;
 
-    if (right < minHeap->size && minHeap->array[right]->freq < minHeap->array[smallest]->freq)
-        smallest = right;
-
-    if (smallest != idx) {
-        swapMinHeapNode(&minHeap->array[smallest], &minHeap->array[idx]);
-        minHeapify(minHeap, smallest);
-    }
-}
+    // main suelta el lock cuando la barrera ya cuenta los hilos que arrancaron
+    pthread_mutex_lock(&pool->lock);
+    pthread_mutex_unlock(&pool->lock);
 
-int isSizeOne(struct MinHeap *minHeap) {
-    return (minHeap->size == 1);
+    read_and_count(pool, self->index);
+    pthread_barrier_wait(&pool->phase);  // frecuencias completas
+    pthread_barrier_wait(&pool->phase);  // main construyó los códigos
+    if (!pool->abort)
+        encode_blocks(pool);
+    return NULL;
 }
+// ----------------------------------------------------------------------------------------
 
-struct MinHeapNode *extractMin(struct MinHeap *minHeap) {
-    struct MinHeapNode *temp = minHeap->array[0];
-    minHeap->array[0] = minHeap->array[minHeap->size - 1];
-    --minHeap->size;
-    minHeapify(minHeap, 0);
-    return temp;
+// Proyecta un archivo en memoria; el histograma y la codificación leen de ahí
+static const char *readFile(const char *filename, struct MappedFile *input, size_t *size) {
+    if (mapFileReadOnly(filename, input, POSIX_MADV_SEQUENTIAL) != 0) return NULL;
+    *size = input->size;
+    return (const char *)input->data;
 }
 
-void insertMinHeap(struct MinHeap *minHeap, struct MinHeapNode *minHeapNode) {
-    ++minHeap->size;
-    int i = minHeap->size - 1;
-    while (i && minHeapNode->freq < minHeap->array[(i - 1) / 2]->freq) {
-        minHeap->array[i] = minHeap->array[(i - 1) / 2];
-        i = (i - 1) / 2;
+// Recorre el árbol con 'threads' hilos y deja los archivos .txt de mayor a
+// menor tamaño, para que el pool empiece por los grandes (el pool se encarga
+// de leerlos)
+static int listDirectory(const char *dirPath, int threads, struct FileList *list, struct FileInfo **filesOut) {
+    *filesOut = NULL;
+    if (walkDirectory(dirPath, threads, list) != 0) {
+        printf("ERROR: No se pudo abrir el directorio %s\n", dirPath);
+        return 0;
     }
-    minHeap->array[i] = minHeapNode;
-}
+    sortLargestFirst(list);
 
-// Almacena los códigos Huffman
-void storeCodes(struct MinHeapNode *root, char *buffer, int depth) {
-    if (!root) return;
-
-    if (!root->left && !root->right) { // hoja
-        buffer[depth] = '\0';
-        codes[codeCount].character = root->data;
-        memcpy(codes[codeCount].code, buffer, depth + 1);
-        codes[codeCount].used = 1;
-        codeCount++;
-        return;
+    struct FileInfo *files = calloc((size_t)(list->count > 0 ? list->count : 1), sizeof(struct FileInfo));
+    if (!files) {
+        printf("ERROR: Memoria insuficiente\n");
+        return 0;
     }
-
-    buffer[depth] = '0';
-    storeCodes(root->left, buffer, depth + 1);
-
-    buffer[depth] = '1';
-    storeCodes(root->right, buffer, depth + 1);
+    for (int i = 0; i < list->count; i++) {
+        files[i].filename = list->entries[i].name;
+        files[i].path = list->entries[i].path;
+    }
+    *filesOut = files;
+    return list->count;
 }
 
-// Construye el árbol de Huffman
-struct MinHeapNode *buildHuffmanTree() {
-    struct MinHeapNode *left, *right, *top;
-    struct MinHeap *minHeap = createMinHeap(freqCount);
-
-    for (int i = 0; i < freqCount; i++) {
-        if (freq[i].used) {
-            insertMinHeap(minHeap, newNode(freq[i].character, freq[i].frequency));
-        }
+// Motor 'threads' (--engine=threads): un pool fijo de hilos lee y cuenta los
+// archivos y, con los códigos ya decididos, codifica sus bloques.
+int compressThreads(const struct CompressOptions *options) {
+    int maxLenLimit = options->maxLen;
+    int blockSize   = options->blockSize;
+    int threadCount = engineJobs(options->jobs);
+    if (statsInit(&stats, "huffman_compressor_pthread", options->statsJson, 0) != 0) {
+        printf("ERROR: Memoria insuficiente\n");
+        return 1;
     }
+    const char *inputDir   = options->inputDir;
+    const char *outputPath = options->outputPath;
 
-    while (!isSizeOne(minHeap)) {
-        left = extractMin(minHeap);
-        right = extractMin(minHeap);
-
-        top = newNode('$', left->freq + right->freq);
-        top->left = left;
-        top->right = right;
+    struct timeval startTime, endTime;
+    gettimeofday(&startTime, NULL);
 
-        insertMinHeap(minHeap, top);
+    // Inicializar
+    memset(codeLens, 0, sizeof(codeLens));
+    memset(codeTable, 0, sizeof(codeTable));
+
+    struct FileList list;
+    struct FileInfo *files;
+    uint64_t t0 = monotonicNs();
+    int fileCount = listDirectory(inputDir, threadCount, &list, &files);
+    statsPhase(&stats, STAT_SCAN, t0, 0, 0);
+    if (fileCount == 0) {
+        printf("No se encontraron archivos .txt en el directorio %s\n", inputDir);
+        return 1;
     }
 
-    struct MinHeapNode *root = extractMin(minHeap);
-    char buffer[MAX_TREE_HT];
-    storeCodes(root, buffer, 0);
-
-    free(minHeap->array);
-    free(minHeap);
-    return root;
-}
-
-// Obtiene el código de un carácter
-char *getCode(char c) {
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used && codes[i].character == c) {
-            return codes[i].code;
-        }
+    // ---------- Lanzar el pool de hilos ----------
+    struct CompressPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.files = files;
+    pool.fileCount = fileCount;
+    pool.blockSize = blockSize;
+    pool.coder.lens = codeLens;
+    pool.coder.codes = codeTable;
+    pool.coder.maxLen = maxLenLimit;
+    pool.coder.adaptive = options->adaptive;
+    pool.hist = calloc((size_t)threadCount, sizeof(*pool.hist));
+    if (!pool.hist) {
+        printf("ERROR: Memoria insuficiente\n");
+        return 1;
     }
-    return "";
-}
-
-// Lee un archivo de texto
-char *readFile(const char *filename, int *size) {
-    FILE *file = fopen(filename, "r");
-    if (!file) return NULL;
 
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char *content = malloc(*size + 1);
-    fread(content, 1, *size, file);
-    content[*size] = '\0';
-
-    fclose(file);
-    return content;
-}
-
-// Lee todos los archivos .txt del directorio
-int readDirectory(const char *dirPath, struct FileInfo *files) {
-    DIR *dir = opendir(dirPath);
-    if (!dir) {
-        printf("Error: No se pudo abrir el directorio %s\n", dirPath);
-        return 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.file_done, NULL);
+
+    // Los hilos esperan a que main suelte 'lock' antes de usar la barrera,
+    // que se crea con los que de verdad arrancaron
+    pthread_t threads[threadCount];
+    struct PoolThread selves[threadCount];
+    int started = 0;
+    pthread_mutex_lock(&pool.lock);
+    for (int t = 0; t < threadCount; t++) {
+        selves[t].pool = &pool;
+        selves[t].index = t;
+        if (pthread_create(&threads[t], NULL, pool_worker, &selves[t]) != 0) break;
+        started++;
     }
+    if (started == 0) {
+        pthread_mutex_unlock(&pool.lock);
+        printf("ERROR: No se pudo crear ningún hilo\n");
+        pthread_cond_destroy(&pool.file_done);
+        pthread_mutex_destroy(&pool.lock);
+        free(pool.hist);
+        free(files);
+        freeFileList(&list);
+        return 1;
+    }
+    if (started < threadCount) {
+        printf("Aviso: Solo se pudieron crear %d de %d hilos\n", started, threadCount);
+        threadCount = started;
+    }
+    pthread_barrier_init(&pool.phase, NULL, (unsigned)threadCount + 1);
+    pthread_mutex_unlock(&pool.lock);
 
-    struct dirent *entry;
-    int fileCount = 0;
-    char fullPath[512];
-
-    while ((entry = readdir(dir)) != NULL && fileCount < MAX_FILES) {
-        if (strstr(entry->d_name, ".txt") != NULL) {
-            sprintf(fullPath, "%s/%s", dirPath, entry->d_name);
+    printf("Leyendo %d archivos con %d hilos...\n", fileCount, threadCount);
+    pthread_barrier_wait(&pool.phase);  // fase 1 terminada
+    //--------------------------------------------------------------
 
-            strcpy(files[fileCount].filename, entry->d_name);
-            files[fileCount].content = readFile(fullPath, &files[fileCount].size);
+    // Reducción de los histogramas por hilo, ya sin concurrencia
+    uint64_t symFreq[HUFF_SYMBOLS] = {0};
+    for (int t = 0; t < threadCount; t++)
+        for (int c = 0; c < MAX_CHARS; c++)
+            symFreq[c] += pool.hist[t][c];
 
-            if (files[fileCount].content != NULL) {
-                printf("Archivo leído: %s (%d bytes)\n", entry->d_name, files[fileCount].size);
-                fileCount++;
-            }
+    // Descartar los archivos que no se pudieron leer
+    int kept = 0;
+    for (int i = 0; i < fileCount; i++) {
+        if (!files[i].content) {
+            printf("ERROR: No se pudo leer %s\n", files[i].filename);
+            continue;
         }
+        printf("Archivo leído: %s (%zu bytes)\n", files[i].filename, files[i].size);
+        if (kept != i) files[kept] = files[i];
+        files[kept].failed = 0;
+        kept++;
     }
+    fileCount = kept;
+    pool.fileCount = kept;
 
-    closedir(dir);
-    return fileCount;
-}
-
-// Convierte string binario a bytes
-void stringToBinary(const char *binStr, FILE *outFile) {
-    int len = strlen(binStr);
-    unsigned char byte = 0;
-    int bitCount = 0;
-
-    for (int i = 0; i < len; i++) {
-        byte = (byte << 1) | (binStr[i] - '0');
-        bitCount++;
+    // Desde aquí todo error pasa por pool.abort: los hilos esperan en la barrera
+    FILE *outFile = NULL;
+    int status = 0;
 
-        if (bitCount == 8) {
-            fwrite(&byte, 1, 1, outFile);
-            byte = 0;
-            bitCount = 0;
-        }
+    if (statsInitFiles(&stats, fileCount) != 0) {
+        printf("ERROR: Memoria insuficiente\n");
+        status = 1;
     }
+    for (int i = 0; i < stats.fileCount; i++) stats.files[i].name = files[i].filename;
 
-    // Escribir bits restantes si los hay
-    if (bitCount > 0) {
-        byte <<= (8 - bitCount);
-        fwrite(&byte, 1, 1, outFile);
-        int lastBits = bitCount;
-        fwrite(&lastBits, sizeof(int), 1, outFile);
-    } else {
-        int lastBits = 8;
-        fwrite(&lastBits, sizeof(int), 1, outFile);
+    if (status == 0 && fileCount == 0) {
+        printf("No se encontraron archivos .txt en el directorio %s\n", inputDir);
+        status = 1;
     }
-}
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Uso: %s <directorio_entrada> <archivo_salida.bin>\n", argv[0]);
-        return 1;
+    uint64_t treeStart = monotonicNs();
+    if (status == 0) {
+        printf("Construyendo árbol de Huffman...\n");
+
+        // Longitudes óptimas, limitadas a -L (o a 64 bits como máximo)
+        uint64_t optimalBits = 0, limitedBits = 0;
+        int limited = buildCodeLengths(symFreq, maxLenLimit, codeLens, &optimalBits, &limitedBits);
+        if (limited < 0) {
+            printf("ERROR: %d bits no alcanzan para %d símbolos\n", maxLenLimit, symbolCount(symFreq));
+            status = 1;
+        } else if (limited > 0) {
+            printf("Códigos limitados a %d bits: %llu -> %llu bits (+%.3f%%)\n",
+                   maxLenLimit > 0 ? maxLenLimit : HUFF_MAX_CODE_LEN,
+                   (unsigned long long)optimalBits, (unsigned long long)limitedBits,
+                   optimalBits ? 100.0 * (double)(limitedBits - optimalBits) / (double)optimalBits : 0.0);
+        }
     }
 
-    struct timeval startTime, endTime;
-    gettimeofday(&startTime, NULL);
-
-    struct FileInfo files[MAX_FILES];
-    pthread_t threads[MAX_FILES];
-    int thread_count = 0;
-
-    // Inicializar
-    memset(freq, 0, sizeof(freq));
-    memset(codes, 0, sizeof(codes));
-    freqCount = 0;
-    codeCount = 0;
-
-    pthread_mutex_init(&freq_mutex, NULL);
-
-    // ---------- Lanzar hilos para calcular frecuencias ----------
-    DIR *dir = opendir(argv[1]);
-    if (!dir) {
-        printf("ERROR: No se pudo abrir el directorio %s\n", argv[1]);
-        return 1;
+    if (status == 0 && assignCanonicalCodes(codeLens, codeTable) != 0) {
+        printf("ERROR: algún código supera %d bits\n", HUFF_MAX_CODE_LEN);
+        status = 1;
     }
-
-    struct dirent *entry;
-    char fullPath[512];
-
-    while ((entry = readdir(dir)) != NULL && thread_count < MAX_FILES) {
-        if (strstr(entry->d_name, ".txt") != NULL) {
-            struct ThreadDataCompressor *data = malloc(sizeof(struct ThreadDataCompressor));
-            sprintf(fullPath, "%s/%s", argv[1], entry->d_name);
-            strcpy(data->filepath, fullPath);
-            pthread_create(&threads[thread_count], NULL, process_file_compress, data);
-            thread_count++;
+    if (status == 0) statsPhase(&stats, STAT_TREE, treeStart, 0, 0);
+
+    if (status == 0) {
+        outFile = fopen(outputPath, "wb");
+        t0 = monotonicNs();
+        if (!outFile) {
+            printf("ERROR: No se pudo crear el archivo de salida\n");
+            status = 1;
+        } else if (writeArchiveHeader(outFile, fileCount, blockSize, codeLens) != 0) {
+            printf("ERROR: No se pudo escribir la cabecera\n");
+            status = 1;
+        } else {
+            statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)ftello(outFile));
         }
     }
-    closedir(dir);
 
-    for (int i = 0; i < thread_count; i++) {
-        pthread_join(threads[i], NULL);
+    // Preparar la cola de bloques de todos los archivos
+    if (status == 0) {
+        for (int i = 0; i < fileCount; i++) {
+            files[i].blockCount = blockCountFor(files[i].size, blockSize);
+            files[i].blocks = calloc((size_t)(files[i].blockCount > 0 ? files[i].blockCount : 1),
+                                     sizeof(struct EncodedBlock));
+            files[i].pending = files[i].blockCount;
+            files[i].done = files[i].blockCount == 0;
+            pool.unit_count += files[i].blockCount;
+            if (!files[i].blocks) status = 1;
+        }
+        pool.unit_file = malloc((size_t)(pool.unit_count > 0 ? pool.unit_count : 1) * sizeof(int));
+        pool.unit_block = malloc((size_t)(pool.unit_count > 0 ? pool.unit_count : 1) * sizeof(int));
+        if (!pool.unit_file || !pool.unit_block) status = 1;
+        if (status != 0) printf("ERROR: Sin memoria para la cola de bloques\n");
     }
-
-    pthread_mutex_destroy(&freq_mutex);
-    //--------------------------------------------------------------
-
-    int fileCount = readDirectory(argv[1], files);
-    if (fileCount == 0) {
-        printf("No se encontraron archivos .txt en el directorio %s\n", argv[1]);
-        return 1;
+    if (status == 0) {
+        for (int i = 0, u = 0; i < fileCount; i++) {
+            for (int b = 0; b < files[i].blockCount; b++, u++) {
+                pool.unit_file[u] = i;
+                pool.unit_block[u] = b;
+            }
+        }
     }
 
-    printf("Construyendo árbol de Huffman...\n");
-    buildHuffmanTree();
-
-    FILE *outFile = fopen(argv[2], "wb");
-    if (!outFile) {
-        printf("ERROR: No se pudo crear el archivo de salida\n");
-        return 1;
-    }
+    pool.abort = status != 0;
+    pthread_barrier_wait(&pool.phase);  // liberar la fase 2
+
+    // Escribir los registros en orden a medida que se completan
+    struct ArchiveToc toc = {0};
+    for (int i = 0; i < fileCount && status == 0; i++) {
+        pthread_mutex_lock(&pool.lock);
+        while (!files[i].done)
+            pthread_cond_wait(&pool.file_done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        if (files[i].failed) {
+            printf("ERROR: Código no encontrado al codificar %s\n", files[i].filename);
+            status = 1;
+            break;
+        }
 
-    fwrite(&fileCount, sizeof(int), 1, outFile);
-    fwrite(&codeCount, sizeof(int), 1, outFile);
+        uint64_t encodedLen = 0;
+        for (int b = 0; b < files[i].blockCount; b++) encodedLen += files[i].blocks[b].bits;
 
-    for (int i = 0; i < codeCount; i++) {
-        if (codes[i].used) {
-            fwrite(&codes[i].character, sizeof(char), 1, outFile);
-            int codeLen = strlen(codes[i].code);
-            fwrite(&codeLen, sizeof(int), 1, outFile);
-            fwrite(codes[i].code, sizeof(char), codeLen, outFile);
+        off_t recordStart = ftello(outFile);
+        t0 = monotonicNs();
+        if (writeFileRecord(outFile, &toc, files[i].filename, (uint64_t)files[i].size, blockSize,
+                            files[i].blocks, files[i].blockCount) != 0) {
+            printf("ERROR: No se pudo escribir %s\n", files[i].filename);
+            status = 1;
+            break;
         }
-    }
+        uint64_t recordBytes = (uint64_t)(ftello(outFile) - recordStart);
+        statsPhase(&stats, STAT_WRITE, t0, 0, recordBytes);
+        statsFile(&stats, i, 0, recordBytes, monotonicNs() - t0);
 
-    for (int i = 0; i < fileCount; i++) {
-        int nameLen = strlen(files[i].filename);
-        fwrite(&nameLen, sizeof(int), 1, outFile);
-        fwrite(files[i].filename, sizeof(char), nameLen, outFile);
-
-        // Codificar contenido (sin strcat → O(n))
-        char *encodedContent = malloc(files[i].size * 20);
-        int pos = 0;
-        for (int j = 0; j < files[i].size; j++) {
-            char *code = getCode(files[i].content[j]);
-            int len = strlen(code);
-            memcpy(encodedContent + pos, code, len);
-            pos += len;
+        printf("Archivo %s codificado: %llu -> %llu bits (%d bloques)\n",
+               files[i].filename, (unsigned long long)files[i].size * 8, (unsigned long long)encodedLen,
+               files[i].blockCount);
+
+        for (int b = 0; b < files[i].blockCount; b++) {
+            free(files[i].blocks[b].data);
+            files[i].blocks[b].data = NULL;
         }
-        encodedContent[pos] = '\0';
+    }
 
-        int encodedLen = pos;
-        fwrite(&encodedLen, sizeof(int), 1, outFile);
-        stringToBinary(encodedContent, outFile);
+    // Índice al final para extraer archivos sueltos
+    off_t tocStart = outFile ? ftello(outFile) : 0;
+    t0 = monotonicNs();
+    if (status == 0 && writeArchiveToc(outFile, &toc) != 0) {
+        printf("ERROR: No se pudo escribir el índice\n");
+        status = 1;
+    }
+    if (status == 0) statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)(ftello(outFile) - tocStart));
+    freeArchiveToc(&toc);
 
-        printf("Archivo %s codificado: %d -> %d bits\n",
-               files[i].filename, files[i].size * 8, encodedLen);
+    // Si main abandona la escritura, los hilos terminan la cola igualmente
+    for (int t = 0; t < threadCount; t++)
+        pthread_join(threads[t], NULL);
 
-        free(encodedContent);
-        free(files[i].content);
+    for (int i = 0; i < fileCount; i++) {
+        if (files[i].blocks)
+            for (int b = 0; b < files[i].blockCount; b++) free(files[i].blocks[b].data);
+        free(files[i].blocks);
+        unmapFile(&files[i].input);
     }
-
-    fclose(outFile);
+    free(files);
+    freeFileList(&list);
+    free(pool.unit_file);
+    free(pool.unit_block);
+    pthread_barrier_destroy(&pool.phase);
+    pthread_cond_destroy(&pool.file_done);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.hist);
+
+    if (outFile) fclose(outFile);
+    if (status != 0) return 1;
 
     gettimeofday(&endTime, NULL);
     long long totalMs = elapsedMillis(startTime, endTime);
-    printf("\nCompresión completada: %s\n", argv[2]);
+    printf("\nCompresión completada: %s\n", outputPath);
     printf("Tiempo total de compresión: %lld ms\n", totalMs);
 
+    statsWriteJson(&stats, stderr);
+    statsFree(&stats);
     return 0;
 }
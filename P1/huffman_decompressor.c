@@ -1,25 +1,24 @@
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <unistd.h>
 
-#define MAX_CHARS 256
-#define MAX_TREE_HT 256
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_lib.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
 
 
-struct MinHeapNode {
-    char data;
-    struct MinHeapNode *left, *right;
-};
+static struct RunStats stats; // --stats=json
 
-struct CodeInfo {
-    char character;
-    char code[MAX_TREE_HT];
-};
-
-long long elapsedMillis(struct timeval start, struct timeval end)
+static long long elapsedMillis(struct timeval start, struct timeval end)
 {
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
@@ -33,262 +32,315 @@ long long elapsedMillis(struct timeval start, struct timeval end)
 }
 
 
-struct MinHeapNode* newNode(char data)
+// Descomprime un flujo de tubería trama a trama: cada trama trae su tabla y
+// libhuffman solo la reconstruye cuando cambia respecto de la anterior.
+static int decompressPipe(FILE* in, FILE* out)
 {
-    struct MinHeapNode* node = malloc(sizeof(struct MinHeapNode));
-    node->left = node->right = NULL;
-    node->data = data;
-    return node;
-}
+    if (readPipeHeader(in) != 0) return -1;
 
+    struct HuffmanDecompressor ctx;
+    initHuffmanDecompressor(&ctx);
+    ctx.stats = &stats;
 
-struct MinHeapNode* buildTreeFromCodes(struct CodeInfo* codes, int codeCount)
-{
-    struct MinHeapNode* root = newNode('$');
-    
-    for (int i = 0; i < codeCount; i++) {
-        struct MinHeapNode* current = root;
-        char* code = codes[i].code;
-        
-        for (int j = 0; code[j] != '\0'; j++) {
-            if (code[j] == '0') {
-                if (current->left == NULL) {
-                    current->left = newNode('$');
-                }
-                current = current->left;
-            } else {
-                if (current->right == NULL) {
-                    current->right = newNode('$');
-                }
-                current = current->right;
-            }
-        }
-        current->data = codes[i].character;
-    }
-    
-    return root;
-}
-
-
-char* binaryToString(FILE* inFile, int bitLength, int lastBitCount)
-{
-    int byteCount = (bitLength + 7) / 8;
-    char* binStr = malloc(bitLength + 10);
-    unsigned char* bytes = malloc(byteCount + 1);
-    
-    if (!binStr || !bytes) {
-        printf("Error: No se pudo reservar memoria\n");
-        return NULL;
-    }
-    
-    size_t bytesRead = fread(bytes, 1, byteCount, inFile);
-    if (bytesRead != byteCount) {
-        printf("Error: Solo se pudieron leer %zu de %d bytes\n", bytesRead, byteCount);
-    }
-    
-    int bitIndex = 0;
-    for (int i = 0; i < (int)bytesRead; i++) {
-        unsigned char byte = bytes[i];
-        int bitsToRead = 8;
-        
-       
-        if (i == (int)bytesRead - 1 && lastBitCount != 8) {
-            bitsToRead = lastBitCount;
+    unsigned char* packed = NULL;
+    unsigned char* decoded = NULL;
+    size_t packedCap = 0, decodedCap = 0;
+    int rc = 0, more;
+    uint8_t lens[HUFF_SYMBOLS];
+    uint64_t rawBytes, bits;
+    for (;;) {
+        uint64_t t0 = monotonicNs();
+        more = readPipeFrame(in, lens, &rawBytes, &bits, &packed, &packedCap);
+        if (more == 0) break;
+        if (more < 0) {
+            rc = -1;
+            break;
         }
-        
-        for (int j = 7; j >= 8 - bitsToRead && bitIndex < bitLength; j--) {
-            binStr[bitIndex++] = ((byte >> j) & 1) ? '1' : '0';
+        statsPhase(&stats, STAT_READ, t0, (bits + 7) / 8, 0);
+        if (rawBytes > decodedCap) {
+            unsigned char* grown = realloc(decoded, (size_t)rawBytes);
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+            decoded = grown;
+            decodedCap = (size_t)rawBytes;
         }
-    }
-    
-    binStr[bitIndex] = '\0';
-    free(bytes);
-    return binStr;
-}
 
-char* decode_file(struct MinHeapNode* root, char* s)
-{
-    if (!root || !s) return NULL;
-    
-    int len = strlen(s);
-    char* ans = malloc(len * 2 + 1); 
-    struct MinHeapNode* curr = root;
-    int ansIndex = 0;
-    
-    for (int i = 0; i < len; i++) {
-        if (s[i] == '0') {
-            if (curr->left) curr = curr->left;
-        } else if (s[i] == '1') {
-            if (curr->right) curr = curr->right;
+        if (decompressFrame(&ctx, lens, packed, bits, decoded, rawBytes) != 0) {
+            rc = -1;
+            break;
         }
 
-      
-        if (curr && curr->left == NULL && curr->right == NULL && curr->data != '$') {
-            ans[ansIndex++] = curr->data;
-            curr = root;
-        }
-        
-      
-        if (!curr) {
-            printf("Error: Árbol corrupto en posición %d\n", i);
+        t0 = monotonicNs();
+        if (fwrite(decoded, 1, (size_t)rawBytes, out) != (size_t)rawBytes) {
+            rc = -1;
             break;
         }
+        statsPhase(&stats, STAT_WRITE, t0, 0, rawBytes);
     }
-    ans[ansIndex] = '\0';
-    return ans;
+    if (rc == 0 && fflush(out) != 0) rc = -1;
+
+    freeHuffmanDecompressor(&ctx);
+    free(packed);
+    free(decoded);
+    return rc;
 }
 
-int main(int argc, char* argv[])
+// Motor 'serial' (--engine=serial): decodifica los archivos uno tras otro en
+// el hilo principal.
+int decompressSerial(const struct DecompressOptions* options)
 {
-    if (argc != 3) {
-        printf("Uso: %s <archivo_comprimido.bin> <directorio_salida>\n", argv[0]);
+    char** patterns = options->patterns;
+    int patternCount = options->patternCount;
+    if (statsInit(&stats, "huffman_decompressor", options->statsJson, 0) != 0) {
+        perror("calloc");
         return 1;
     }
+    const char* archivePath = options->archivePath;
+    const char* outputDir   = options->outputDir;
 
     struct timeval startTime, endTime;
     gettimeofday(&startTime, NULL);
     
-    FILE* inFile = fopen(argv[1], "rb");
-    if (!inFile) {
-        printf("Error: No se pudo abrir el archivo %s\n", argv[1]);
+    struct MappedFile archive;
+    uint64_t t0 = monotonicNs();
+    if (mapFileReadOnly(archivePath, &archive, patternCount ? POSIX_MADV_RANDOM : POSIX_MADV_SEQUENTIAL) != 0) {
+        printf("Error: No se pudo abrir el archivo %s\n", archivePath);
         return 1;
     }
+    statsPhase(&stats, STAT_READ, t0, archive.size, 0);
+    struct ArchiveView view = { archive.data, archive.size, 0 };
     
-    mkdir(argv[2], 0755);
+    mkdir(outputDir, 0755);
     
-    int fileCount, codeCount;
-    if (fread(&fileCount, sizeof(int), 1, inFile) != 1 ||
-        fread(&codeCount, sizeof(int), 1, inFile) != 1) {
-        printf("Error: No se pudo leer la cabecera\n");
-        fclose(inFile);
+    int fileCount, blockSize;
+    uint8_t codeLens[HUFF_SYMBOLS];
+    struct ArchiveToc toc;
+    t0 = monotonicNs();
+    if (parseArchiveHeader(&view, &fileCount, &blockSize, codeLens) != 0 ||
+        parseArchiveToc(&view, &toc) != 0) {
+        printf("Error: Cabecera inválida o archivo no comprimido con esta versión\n");
+        unmapFile(&archive);
         return 1;
     }
-    
+    if (toc.count != fileCount) {
+        printf("Error: El índice no coincide con la cabecera\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
+        return 1;
+    }
+    statsPhase(&stats, STAT_PARSE, t0, 0, 0);
+
+    // Códigos canónicos derivados de las longitudes
+    struct HuffCode huffCodes[HUFF_SYMBOLS];
+    int codeCount = 0, maxCodeLen = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        if (codeLens[s] > 0) codeCount++;
+        if (codeLens[s] > maxCodeLen) maxCodeLen = codeLens[s];
+    }
+
     printf("Archivos a descomprimir: %d\n", fileCount);
-    printf("Códigos en tabla: %d\n", codeCount);
-    
-    if (codeCount <= 0 || codeCount > MAX_CHARS) {
-        printf("Error: Número de códigos inválido: %d\n", codeCount);
-        fclose(inFile);
+    printf("Códigos en tabla: %d (máx. %d bits)\n", codeCount, maxCodeLen);
+
+    struct DecodeTable table;
+    t0 = monotonicNs();
+    if (assignCanonicalCodes(codeLens, huffCodes) != 0 ||
+        buildDecodeTable(&table, huffCodes) != 0) {
+        printf("Error: Las longitudes de código no forman un código prefijo válido\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
+        return 1;
+    }
+    statsPhase(&stats, STAT_TABLE, t0, 0, 0);
+    struct DecodeTable scratch = {0}; // para los bloques que traen su propia tabla
+
+    // Un contador por entrada del índice; las no seleccionadas quedan fuera
+    if (statsInitFiles(&stats, toc.count) != 0) {
+        perror("calloc");
         return 1;
     }
     
-    struct CodeInfo* codes = malloc(codeCount * sizeof(struct CodeInfo));
-    for (int i = 0; i < codeCount; i++) {
-        if (fread(&codes[i].character, sizeof(char), 1, inFile) != 1) {
-            printf("Error leyendo carácter %d\n", i);
-            break;
-        }
+    // El índice lleva directamente a cada registro seleccionado
+    int selected = 0, failed = 0;
+    for (int i = 0; i < toc.count; i++) {
+        const struct TocEntry* entry = &toc.entries[i];
+        if (!tocNameSelected(entry->name, patterns, patternCount)) continue;
+        selected++;
+        if (stats.files) stats.files[i].name = entry->name;
+        printf("\nProcesando archivo %d/%d...\n", i+1, fileCount);
         
-        int codeLen;
-        if (fread(&codeLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud de código %d\n", i);
+        struct FileRecord rec;
+        t0 = monotonicNs();
+        if (parseFileRecordAt(&view, entry->offset, blockSize, &rec) != 0) {
+            printf("Error leyendo el registro del archivo\n");
+            failed = 1;
             break;
         }
-        
-        if (codeLen <= 0 || codeLen >= MAX_TREE_HT) {
-            printf("Error: Longitud de código inválida: %d\n", codeLen);
-            break;
+        statsPhase(&stats, STAT_PARSE, t0, 0, 0);
+        uint64_t fileStart = monotonicNs();
+
+        uint64_t encodedLen = 0;
+        for (int b = 0; b < rec.blockCount; b++) encodedLen += rec.blockBits[b];
+        printf("Archivo: %s, bits codificados: %llu (%d bloques)\n",
+               rec.name, (unsigned long long)encodedLen, rec.blockCount);
+
+        size_t cap = recordOutputCapacity(&table, &rec, blockSize);
+        unsigned char* decodedContent = malloc(cap + 1);
+        long long decodedLen = -1;
+        if (decodedContent) {
+            t0 = monotonicNs();
+            decodedLen = decodeRecordRange(&table, &scratch, &rec, blockSize, 0, rec.blockCount,
+                                           decodedContent, cap);
+            statsPhase(&stats, STAT_DECODE, t0, (uint64_t)rec.payloadBytes,
+                       decodedLen > 0 ? (uint64_t)decodedLen : 0);
         }
-        
-        if (fread(codes[i].code, sizeof(char), codeLen, inFile) != codeLen) {
-            printf("Error leyendo código %d\n", i);
-            break;
+
+        if (decodedLen < 0 || (uint64_t)decodedLen != entry->originalSize) {
+            printf("Error: Datos codificados corruptos en %s\n", rec.name);
+            failed = 1;
+        } else {
+            char outputPath[ARCHIVE_PATH_MAX];
+            FILE* outFile = NULL;
+            if (prepareOutputPath(outputDir, rec.name, outputPath, sizeof(outputPath)) != 0) {
+                printf("Error: Nombre de archivo no válido: %s\n", rec.name);
+                failed = 1;
+            } else if (!(outFile = fopen(outputPath, "wb"))) {
+                perror(outputPath);
+                printf("Error: No se pudo crear %s\n", outputPath);
+                failed = 1;
+            }
+            if (outFile) {
+                t0 = monotonicNs();
+                size_t written = fwrite(decodedContent, 1, (size_t)decodedLen, outFile);
+                if (fclose(outFile) != 0 || written != (size_t)decodedLen) {
+                    printf("Error: No se pudo escribir %s\n", outputPath);
+                    failed = 1;
+                } else {
+                    statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)decodedLen);
+                    printf("Archivo descomprimido: %s\n", rec.name);
+                }
+            }
         }
-        codes[i].code[codeLen] = '\0';
         
-        printf("Código: '%c' -> %s\n", codes[i].character, codes[i].code);
+        statsFile(&stats, i, (uint64_t)rec.payloadBytes, decodedLen > 0 ? (uint64_t)decodedLen : 0,
+                  monotonicNs() - fileStart);
+
+        free(decodedContent);
+        freeFileRecord(&rec);
     }
     
-    struct MinHeapNode* root = buildTreeFromCodes(codes, codeCount);
+    if (patternCount > 0 && selected == 0) {
+        printf("Error: Ningún archivo coincide con los patrones indicados\n");
+        failed = 1;
+    }
+
+    // Los nombres apuntan al índice, que se libera a continuación
+    statsWriteJson(&stats, stderr);
+    freeArchiveToc(&toc);
+    unmapFile(&archive);
+    freeDecodeTable(&table);
+    freeDecodeTable(&scratch);
     
-    for (int i = 0; i < fileCount; i++) {
-        printf("\nProcesando archivo %d/%d...\n", i+1, fileCount);
-        
-        int nameLen;
-        if (fread(&nameLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud del nombre\n");
+    printf("\nDescompresión completada en: %s\n", outputDir);
+    gettimeofday(&endTime, NULL);
+    long long totalMs = elapsedMillis(startTime, endTime);
+    printf("Tiempo total de descompresión: %lld ms\n", totalMs);
+
+    statsFree(&stats);
+    return failed ? 1 : 0;
+}
+
+static void printUsage(const char* program)
+{
+    printf("Uso: %s [--engine=serial|threads|processes] [-j N] [-x patrón]... [--stats=json]\n"
+           "        <archivo_comprimido.bin> <directorio_salida>\n", program);
+    printf("     %s -p [--stats=json] < entrada.huf > salida\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+    // -x patrón (repetible): extraer solo los archivos que coincidan (glob)
+    char* patterns[argc];
+    struct DecompressOptions options = { .patterns = patterns };
+    enum Engine engine = DEFAULT_ENGINE;
+    int pipeMode = 0; // -p: stdin -> stdout
+    static const struct option longOptions[] = {
+        { "engine", required_argument, NULL, 'E' },
+        { "stats",  required_argument, NULL, 'S' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:x:p", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'E':
+            if (parseEngineName(optarg, &engine) != 0) {
+                printf("Error: --engine debe ser serial, threads o processes\n");
+                return 1;
+            }
             break;
-        }
-        
-        if (nameLen <= 0 || nameLen > 1000) {
-            printf("Error: Longitud de nombre inválida: %d\n", nameLen);
+        case 'j':
+            options.jobs = atoi(optarg);
+            if (options.jobs < 1 || options.jobs > 1024) {
+                printf("Error: -j debe estar entre 1 y 1024\n");
+                return 1;
+            }
             break;
-        }
-        
-        char* filename = malloc(nameLen + 1);
-        if (fread(filename, sizeof(char), nameLen, inFile) != nameLen) {
-            printf("Error leyendo nombre del archivo\n");
-            free(filename);
+        case 'x':
+            patterns[options.patternCount++] = optarg;
             break;
-        }
-        filename[nameLen] = '\0';
-        
-        int encodedLen;
-        if (fread(&encodedLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud codificada\n");
-            free(filename);
+        case 'p':
+            pipeMode = 1;
             break;
-        }
-        
-        printf("Archivo: %s, bits codificados: %d\n", filename, encodedLen);
-        
-        int byteCount = (encodedLen + 7) / 8;
-        unsigned char* bytes = malloc(byteCount + 1);
-        
-        if (fread(bytes, 1, byteCount, inFile) != byteCount) {
-            printf("Error leyendo datos binarios\n");
-            free(filename);
-            free(bytes);
+        case 'S':
+            if (parseStatsFormat(optarg) != 0) {
+                printf("Error: --stats solo admite 'json'\n");
+                return 1;
+            }
+            options.statsJson = 1;
             break;
+        default:
+            printUsage(argv[0]);
+            return 1;
         }
-        
-        int lastBitCount;
-        if (fread(&lastBitCount, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo lastBitCount\n");
-            free(filename);
-            free(bytes);
-            break;
+    }
+    if (engine == ENGINE_SERIAL && options.jobs > 1) {
+        printf("Error: -j solo se aplica con --engine=threads o --engine=processes\n");
+        return 1;
+    }
+    if (pipeMode && engine != ENGINE_SERIAL) {
+        printf("Error: -p solo está disponible con --engine=serial\n");
+        return 1;
+    }
+
+    if (pipeMode) {
+        // stdout lleva los datos: los mensajes van a stderr
+        if (argc != optind || options.patternCount > 0) {
+            fprintf(stderr, "Uso: %s -p [--stats=json] < entrada.huf > salida\n", argv[0]);
+            return 1;
         }
-        
-        char* binaryStr = malloc(encodedLen + 10);
-        int bitIndex = 0;
-        
-        for (int b = 0; b < byteCount && bitIndex < encodedLen; b++) {
-            unsigned char byte = bytes[b];
-            int bitsToRead = (b == byteCount - 1) ? lastBitCount : 8;
-            
-            for (int bit = 7; bit >= 8 - bitsToRead && bitIndex < encodedLen; bit--) {
-                binaryStr[bitIndex++] = ((byte >> bit) & 1) ? '1' : '0';
-            }
+        if (statsInit(&stats, "huffman_decompressor", options.statsJson, 0) != 0) {
+            perror("calloc");
+            return 1;
         }
-        binaryStr[bitIndex] = '\0';
-        
-        char* decodedContent = decode_file(root, binaryStr);
-        
-        if (decodedContent) {
-            char outputPath[512];
-            sprintf(outputPath, "%s/%s", argv[2], filename);
-            FILE* outFile = fopen(outputPath, "w");
-            if (outFile) {
-                fprintf(outFile, "%s", decodedContent);
-                fclose(outFile);
-                printf("Archivo descomprimido: %s\n", filename);
-            }
-            free(decodedContent);
+        if (decompressPipe(stdin, stdout) != 0) {
+            fprintf(stderr, "Error: Flujo comprimido inválido o truncado\n");
+            return 1;
         }
-        
-        free(filename);
-        free(bytes);
-        free(binaryStr);
+        statsWriteJson(&stats, stderr);
+        statsFree(&stats);
+        return 0;
     }
-    
-    fclose(inFile);
-    free(codes);
-    
-    printf("\nDescompresión completada en: %s\n", argv[2]);
-    gettimeofday(&endTime, NULL);
-    long long totalMs = elapsedMillis(startTime, endTime);
-    printf("Tiempo total de descompresión: %lld ms\n", totalMs);
-    return 0;
-}
\ No newline at end of file
+    if (argc - optind != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    options.archivePath = argv[optind];
+    options.outputDir   = argv[optind + 1];
+
+    switch (engine) {
+    case ENGINE_THREADS:   return decompressThreads(&options);
+    case ENGINE_PROCESSES: return decompressProcesses(&options);
+    default:               return decompressSerial(&options);
+    }
+}
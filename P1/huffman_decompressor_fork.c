@@ -7,21 +7,20 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
-#define MAX_CHARS 256
-#define MAX_TREE_HT 256
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
 
-struct MinHeapNode {
-    char data;
-    struct MinHeapNode *left, *right;
-};
+static struct RunStats stats; // --stats=json, compartido con los hijos
 
-struct CodeInfo {
-    char character;
-    char code[MAX_TREE_HT];
-};
 
-long long elapsedMillis(struct timeval start, struct timeval end)
+static long long elapsedMillis(struct timeval start, struct timeval end)
 {
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
@@ -32,337 +31,309 @@ long long elapsedMillis(struct timeval start, struct timeval end)
     return seconds * 1000LL + microseconds / 1000LL;
 }
 
-static struct MinHeapNode* newNode(char data)
+static ssize_t pwriteFull(int fd, const void* buffer, size_t count, off_t offset)
 {
-    struct MinHeapNode* node = malloc(sizeof(struct MinHeapNode));
-    if (!node) {
-        perror("malloc");
-        return NULL;
-    }
-    node->left = node->right = NULL;
-    node->data = data;
-    return node;
-}
-
-static struct MinHeapNode* buildTreeFromCodes(struct CodeInfo* codes, int codeCount)
-{
-    struct MinHeapNode* root = newNode('$');
-    if (!root) return NULL;
-
-    for (int i = 0; i < codeCount; i++) {
-        struct MinHeapNode* current = root;
-        char* code = codes[i].code;
-
-        for (int j = 0; code[j] != '\0'; j++) {
-            if (code[j] == '0') {
-                if (current->left == NULL) {
-                    current->left = newNode('$');
-                    if (!current->left) return root;
-                }
-                current = current->left;
-            } else {
-                if (current->right == NULL) {
-                    current->right = newNode('$');
-                    if (!current->right) return root;
-                }
-                current = current->right;
-            }
+    size_t total = 0;
+    const unsigned char* ptr = buffer;
+
+    while (total < count) {
+        ssize_t written = pwrite(fd, ptr + total, count - total, offset + (off_t)total);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
-        current->data = codes[i].character;
+        total += (size_t)written;
     }
-
-    return root;
+    return (ssize_t)total;
 }
 
-static char* bytesToBinaryString(const unsigned char* bytes, int byteCount,
-                                 int encodedLen, int lastBitCount)
-{
-    if (encodedLen <= 0) {
-        char* empty = malloc(1);
-        if (!empty) {
-            perror("malloc");
-            return NULL;
-        }
-        empty[0] = '\0';
-        return empty;
-    }
-
-    char* binStr = malloc((size_t)encodedLen + 1);
-    if (!binStr) {
-        perror("malloc");
-        return NULL;
-    }
+// Registro del archivo ya escaneado; sus datos quedan en la proyección del
+// archivo comprimido, que los hijos heredan
+struct FileEntry {
+    struct FileRecord rec;
+    uint64_t originalSize;  // tamaño esperado según el índice
+    char outputPath[ARCHIVE_PATH_MAX];
+};
 
-    int bitIndex = 0;
-    for (int b = 0; b < byteCount && bitIndex < encodedLen; b++) {
-        unsigned char byte = bytes[b];
-        int bitsToRead = 8;
-        if (b == byteCount - 1) {
-            bitsToRead = (encodedLen % 8 == 0) ? 8 : lastBitCount;
-        }
+// Estado que comparten los hijos (MAP_SHARED)
+struct SharedCursor {
+    int nextUnit;  // siguiente unidad (archivo, bloque) por decodificar
+};
 
-        for (int bit = 7; bit >= 8 - bitsToRead && bitIndex < encodedLen; bit--) {
-            binStr[bitIndex++] = ((byte >> bit) & 1) ? '1' : '0';
-        }
-    }
+// Buffers que cada hijo reutiliza entre unidades
+struct ChildBuffers {
+    unsigned char* out;
+    size_t outCap;
+    int fd;         // archivo de salida abierto
+    int fdFile;     // índice del archivo al que corresponde 'fd'
+    struct DecodeTable scratch; // tabla de los bloques que traen la suya
+};
 
-    binStr[bitIndex] = '\0';
-    return binStr;
+static int growBuffer(unsigned char** buffer, size_t* cap, size_t need)
+{
+    if (need <= *cap) return 0;
+    unsigned char* grown = realloc(*buffer, need);
+    if (!grown) return -1;
+    *buffer = grown;
+    *cap = need;
+    return 0;
 }
 
-static char* decode_file(struct MinHeapNode* root, char* s)
+// Hijo: decodifica el bloque b del archivo en su sitio, desde la proyección
+// del comprimido, y lo escribe en su posición del archivo de salida
+static int decodeUnit(const struct DecodeTable* table, int blockSize,
+                      struct FileEntry* entries, int f, int b, struct ChildBuffers* buf)
 {
-    if (!root || !s) return NULL;
+    const struct FileRecord* rec = &entries[f].rec;
+    size_t cap = blockSize > 0 ? (size_t)blockSize : recordOutputCapacity(table, rec, 0);
 
-    int len = strlen(s);
-    char* ans = malloc((size_t)len * 2 + 1);
-    if (!ans) {
+    if (growBuffer(&buf->out, &buf->outCap, cap + 1) != 0) {
         perror("malloc");
-        return NULL;
+        return -1;
     }
-    struct MinHeapNode* curr = root;
-    int ansIndex = 0;
-
-    for (int i = 0; i < len; i++) {
-        if (s[i] == '0') {
-            if (curr->left) curr = curr->left;
-        } else if (s[i] == '1') {
-            if (curr->right) curr = curr->right;
-        }
 
-        if (curr && curr->left == NULL && curr->right == NULL && curr->data != '$') {
-            ans[ansIndex++] = curr->data;
-            curr = root;
+    uint64_t unitStart = monotonicNs();
+    long long decodedLen = decodeRecordBlock(table, &buf->scratch, rec, b, buf->out, cap);
+    if (decodedLen < 0 ||
+        (blockSize > 0 && b < rec->blockCount - 1 && decodedLen != blockSize)) {
+        printf("Error: Datos codificados corruptos en %s\n", rec->name);
+        return -1;
+    }
+    uint64_t packed = (rec->blockBits[b] + 7) / 8;
+    statsPhase(&stats, STAT_DECODE, unitStart, packed, (uint64_t)decodedLen);
+
+    if (buf->fdFile != f) {
+        if (buf->fd >= 0) close(buf->fd);
+        buf->fd = open(entries[f].outputPath, O_WRONLY);
+        buf->fdFile = f;
+        if (buf->fd < 0) {
+            perror("open");
+            return -1;
         }
+    }
 
-        if (!curr) {
-            printf("Error: Árbol corrupto en posición %d\n", i);
-            free(ans);
-            return NULL;
-        }
+    uint64_t t0 = monotonicNs();
+    off_t offset = (off_t)b * (off_t)blockSize;
+    if (pwriteFull(buf->fd, buf->out, (size_t)decodedLen, offset) != decodedLen) {
+        perror("pwrite");
+        return -1;
     }
-    ans[ansIndex] = '\0';
-    return ans;
+    statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)decodedLen);
+    statsFile(&stats, f, packed, (uint64_t)decodedLen, monotonicNs() - unitStart);
+    return 0;
 }
 
-int main(int argc, char* argv[])
+// Motor 'processes' (--engine=processes): los bloques de los archivos
+// elegidos se reparten entre procesos hijos, que escriben cada bloque con
+// pwrite en su desplazamiento del archivo de salida.
+int decompressProcesses(const struct DecompressOptions* options)
 {
-    if (argc != 3) {
-        printf("Uso: %s <archivo_comprimido.bin> <directorio_salida>\n", argv[0]);
+    int workerCount = engineJobs(options->jobs);
+    char** patterns = options->patterns;
+    int patternCount = options->patternCount;
+    if (statsInit(&stats, "huffman_decompressor_fork", options->statsJson, 1) != 0) {
+        perror("mmap");
         return 1;
     }
+    const char* archivePath = options->archivePath;
+    const char* outputDir   = options->outputDir;
 
     struct timeval startTime, endTime;
     gettimeofday(&startTime, NULL);
 
-    FILE* inFile = fopen(argv[1], "rb");
-    if (!inFile) {
-        printf("Error: No se pudo abrir el archivo %s\n", argv[1]);
+    struct MappedFile archive;
+    uint64_t t0 = monotonicNs();
+    if (mapFileReadOnly(archivePath, &archive, patternCount ? POSIX_MADV_RANDOM : POSIX_MADV_WILLNEED) != 0) {
+        printf("Error: No se pudo abrir el archivo %s\n", archivePath);
         return 1;
     }
-
-    mkdir(argv[2], 0755);
-
-    int fileCount, codeCount;
-    if (fread(&fileCount, sizeof(int), 1, inFile) != 1 ||
-        fread(&codeCount, sizeof(int), 1, inFile) != 1) {
-        printf("Error: No se pudo leer la cabecera\n");
-        fclose(inFile);
+    statsPhase(&stats, STAT_READ, t0, archive.size, 0);
+    struct ArchiveView view = { archive.data, archive.size, 0 };
+
+    mkdir(outputDir, 0755);
+
+    int fileCount, blockSize;
+    uint8_t codeLens[HUFF_SYMBOLS];
+    struct ArchiveToc toc;
+    t0 = monotonicNs();
+    if (parseArchiveHeader(&view, &fileCount, &blockSize, codeLens) != 0 ||
+        parseArchiveToc(&view, &toc) != 0) {
+        printf("Error: Cabecera inválida o archivo no comprimido con esta versión\n");
+        unmapFile(&archive);
         return 1;
     }
-
-    printf("Archivos a descomprimir: %d\n", fileCount);
-    printf("Códigos en tabla: %d\n", codeCount);
-
-    if (codeCount <= 0 || codeCount > MAX_CHARS) {
-        printf("Error: Número de códigos inválido: %d\n", codeCount);
-        fclose(inFile);
+    if (toc.count != fileCount) {
+        printf("Error: El índice no coincide con la cabecera\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
         return 1;
     }
+    statsPhase(&stats, STAT_PARSE, t0, 0, 0);
+
+    // Códigos canónicos derivados de las longitudes
+    struct HuffCode huffCodes[HUFF_SYMBOLS];
+    int codeCount = 0, maxCodeLen = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++) {
+        if (codeLens[s] > 0) codeCount++;
+        if (codeLens[s] > maxCodeLen) maxCodeLen = codeLens[s];
+    }
 
-    struct CodeInfo* codes = malloc((size_t)codeCount * sizeof(struct CodeInfo));
-    if (!codes) {
-        perror("malloc");
-        fclose(inFile);
+    printf("Archivos a descomprimir: %d\n", fileCount);
+    printf("Códigos en tabla: %d (máx. %d bits)\n", codeCount, maxCodeLen);
+
+    struct DecodeTable table;
+    t0 = monotonicNs();
+    if (assignCanonicalCodes(codeLens, huffCodes) != 0 ||
+        buildDecodeTable(&table, huffCodes) != 0) {
+        printf("Error: Las longitudes de código no forman un código prefijo válido\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
         return 1;
     }
+    statsPhase(&stats, STAT_TABLE, t0, 0, 0);
 
-    for (int i = 0; i < codeCount; i++) {
-        if (fread(&codes[i].character, sizeof(char), 1, inFile) != 1) {
-            printf("Error leyendo carácter %d\n", i);
-            free(codes);
-            fclose(inFile);
-            return 1;
-        }
-
-        int codeLen;
-        if (fread(&codeLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud de código %d\n", i);
-            free(codes);
-            fclose(inFile);
-            return 1;
-        }
-
-        if (codeLen <= 0 || codeLen >= MAX_TREE_HT) {
-            printf("Error: Longitud de código inválida: %d\n", codeLen);
-            free(codes);
-            fclose(inFile);
-            return 1;
-        }
-
-        if (fread(codes[i].code, sizeof(char), codeLen, inFile) != (size_t)codeLen) {
-            printf("Error leyendo código %d\n", i);
-            free(codes);
-            fclose(inFile);
-            return 1;
-        }
-        codes[i].code[codeLen] = '\0';
-
-        printf("Código: '%c' -> %s\n", codes[i].character, codes[i].code);
+    // Un contador por archivo seleccionado, en memoria compartida con los hijos
+    if (statsInitFiles(&stats, fileCount) != 0) {
+        perror("mmap");
+        return 1;
     }
 
-    struct MinHeapNode* root = buildTreeFromCodes(codes, codeCount);
-    if (!root) {
-        fprintf(stderr, "Error al reconstruir el árbol de Huffman\n");
-        free(codes);
-        fclose(inFile);
+    // El índice lleva directamente a cada registro seleccionado, sin copiar sus datos
+    struct FileEntry* entries = calloc((size_t)(fileCount > 0 ? fileCount : 1), sizeof(struct FileEntry));
+    if (!entries) {
+        perror("calloc");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
         return 1;
     }
 
-    for (int i = 0; i < fileCount; i++) {
-        printf("\nProcesando archivo %d/%d...\n", i + 1, fileCount);
-
-        int nameLen;
-        if (fread(&nameLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud del nombre\n");
+    int scanned = 0, selected = 0, unitCount = 0;
+    for (int i = 0; i < toc.count; i++) {
+        if (!tocNameSelected(toc.entries[i].name, patterns, patternCount)) continue;
+        selected++;
+        struct FileEntry* e = &entries[scanned];
+        t0 = monotonicNs();
+        if (parseFileRecordAt(&view, toc.entries[i].offset, blockSize, &e->rec) != 0) {
+            printf("Error leyendo el registro del archivo %d/%d\n", i + 1, fileCount);
             break;
         }
-
-        if (nameLen <= 0 || nameLen > 1000) {
-            printf("Error: Longitud de nombre inválida: %d\n", nameLen);
+        statsPhase(&stats, STAT_PARSE, t0, 0, 0);
+        e->originalSize = toc.entries[i].originalSize;
+        if (prepareOutputPath(outputDir, e->rec.name, e->outputPath, sizeof(e->outputPath)) != 0) {
+            printf("Error: Nombre de archivo no válido: %s\n", e->rec.name);
+            freeFileRecord(&e->rec);
             break;
         }
 
-        char* filename = malloc((size_t)nameLen + 1);
-        if (!filename) {
-            perror("malloc");
+        // Crear (o vaciar) la salida antes de que los hijos escriban en ella
+        int fd = open(e->outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            perror("open");
+            freeFileRecord(&e->rec);
             break;
         }
+        close(fd);
 
-        if (fread(filename, sizeof(char), nameLen, inFile) != (size_t)nameLen) {
-            printf("Error leyendo nombre del archivo\n");
-            free(filename);
-            break;
-        }
-        filename[nameLen] = '\0';
+        if (stats.files) stats.files[scanned].name = e->rec.name;
+        scanned++;
+        unitCount += e->rec.blockCount;
+    }
 
-        int encodedLen;
-        if (fread(&encodedLen, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo longitud codificada\n");
-            free(filename);
-            break;
+    int* unitFile  = malloc((size_t)(unitCount > 0 ? unitCount : 1) * sizeof(int));
+    int* unitBlock = malloc((size_t)(unitCount > 0 ? unitCount : 1) * sizeof(int));
+    struct SharedCursor* cursor = mmap(NULL, sizeof(struct SharedCursor), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!unitFile || !unitBlock || cursor == MAP_FAILED) {
+        perror("malloc");
+        return 1;
+    }
+    cursor->nextUnit = 0;
+    for (int i = 0, u = 0; i < scanned; i++) {
+        for (int b = 0; b < entries[i].rec.blockCount; b++, u++) {
+            unitFile[u] = i;
+            unitBlock[u] = b;
         }
+    }
 
-        printf("Archivo: %s, bits codificados: %d\n", filename, encodedLen);
-
-        int byteCount = (encodedLen + 7) / 8;
-        unsigned char* bytes = NULL;
-        if (byteCount > 0) {
-            bytes = malloc((size_t)byteCount);
-            if (!bytes) {
-                perror("malloc");
-                free(filename);
-                break;
-            }
-
-            if (fread(bytes, 1, (size_t)byteCount, inFile) != (size_t)byteCount) {
-                printf("Error leyendo datos binarios\n");
-                free(filename);
-                free(bytes);
-                break;
-            }
-        }
+    if (workerCount > unitCount) workerCount = unitCount;
 
-        int lastBitCount;
-        if (fread(&lastBitCount, sizeof(int), 1, inFile) != 1) {
-            printf("Error leyendo lastBitCount\n");
-            free(filename);
-            free(bytes);
-            break;
-        }
+    printf("\nDecodificando %d bloques de %d archivos con %d procesos...\n",
+           unitCount, scanned, workerCount);
 
+    // Hijos concurrentes: cada uno toma unidades del contador compartido
+    pid_t pids[workerCount > 0 ? workerCount : 1];
+    int launched = 0, failed = scanned < selected;
+    if (patternCount > 0 && selected == 0) {
+        printf("Error: Ningún archivo coincide con los patrones indicados\n");
+        failed = 1;
+    }
+    fflush(stdout);
+    for (int w = 0; w < workerCount; w++) {
         pid_t pid = fork();
         if (pid == -1) {
             perror("fork");
-            free(filename);
-            free(bytes);
+            failed = 1;
             break;
         }
-
         if (pid == 0) {
-            char* binaryStr = bytesToBinaryString(bytes, byteCount, encodedLen, lastBitCount);
-            if (!binaryStr) {
-                free(filename);
-                free(bytes);
-                _exit(1);
-            }
-
-            char* decodedContent = decode_file(root, binaryStr);
-            if (!decodedContent) {
-                free(binaryStr);
-                free(filename);
-                free(bytes);
-                _exit(1);
-            }
-
-            char outputPath[512];
-            snprintf(outputPath, sizeof(outputPath), "%s/%s", argv[2], filename);
-            FILE* outFile = fopen(outputPath, "w");
-            if (!outFile) {
-                perror("fopen");
-                free(decodedContent);
-                free(binaryStr);
-                free(filename);
-                free(bytes);
-                _exit(1);
+            struct ChildBuffers buf = { NULL, 0, -1, -1, {0} };
+            int rc = 0;
+            for (;;) {
+                int u = __atomic_fetch_add(&cursor->nextUnit, 1, __ATOMIC_RELAXED);
+                if (u >= unitCount) break;
+                if (decodeUnit(&table, blockSize, entries, unitFile[u], unitBlock[u], &buf) != 0) {
+                    rc = 1;
+                    break;
+                }
             }
+            if (buf.fd >= 0) close(buf.fd);
+            fflush(stdout);
+            _exit(rc);
+        }
+        pids[launched++] = pid;
+    }
 
-            fprintf(outFile, "%s", decodedContent);
-            fclose(outFile);
-
-            free(decodedContent);
-            free(binaryStr);
-            free(filename);
-            free(bytes);
-            _exit(0);
-        } else {
-            int status = 0;
-            if (waitpid(pid, &status, 0) == -1) {
-                perror("waitpid");
-                free(filename);
-                free(bytes);
-                break;
-            }
-            if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                printf("El proceso hijo para %s terminó con código %d\n", filename, WEXITSTATUS(status));
-                free(filename);
-                free(bytes);
-                break;
-            }
+    for (int w = 0; w < launched; w++) {
+        int status = 0;
+        if (waitpid(pids[w], &status, 0) == -1) {
+            perror("waitpid");
+            failed = 1;
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("El proceso hijo %d terminó con error\n", pids[w]);
+            failed = 1;
+        }
+    }
 
-            printf("Archivo descomprimido: %s (PID %d)\n", filename, pid);
-            free(filename);
-            free(bytes);
+    // Cada salida debe tener el tamaño que anota el índice
+    for (int i = 0; i < scanned && !failed; i++) {
+        struct stat st;
+        if (stat(entries[i].outputPath, &st) != 0 || (uint64_t)st.st_size != entries[i].originalSize) {
+            printf("Error: Datos codificados corruptos en %s\n", entries[i].rec.name);
+            failed = 1;
         }
     }
 
-    fclose(inFile);
-    free(codes);
+    if (!failed) {
+        for (int i = 0; i < scanned; i++)
+            printf("Archivo descomprimido: %s (%d bloques)\n", entries[i].rec.name, entries[i].rec.blockCount);
+    }
 
-    printf("\nDescompresión completada en: %s\n", argv[2]);
+    // Los nombres apuntan a los registros, que se liberan a continuación
+    statsWriteJson(&stats, stderr);
+    for (int i = 0; i < scanned; i++) freeFileRecord(&entries[i].rec);
+    free(entries);
+    freeArchiveToc(&toc);
+    free(unitFile);
+    free(unitBlock);
+    munmap(cursor, sizeof(struct SharedCursor));
+    unmapFile(&archive);
+    freeDecodeTable(&table);
+
+    printf("\nDescompresión completada en: %s\n", outputDir);
     gettimeofday(&endTime, NULL);
     long long totalMs = elapsedMillis(startTime, endTime);
     printf("Tiempo total de descompresión: %lld ms\n", totalMs);
-    
-    return 0;
-}
\ No newline at end of file
+
+    statsFree(&stats);
+    return failed ? 1 : 0;
+}
@@ -6,33 +6,45 @@
 #include <pthread.h>  // Manejo de hilos
 #include <sys/time.h> // Para medir el tiempo
 
-#define MAX_CHARS 256
-#define MAX_TREE_HT 256
+#include "huffman_archive.h"
+#include "huffman_codec.h"
+#include "huffman_engine.h"
+#include "huffman_mmap.h"
+#include "huffman_stats.h"
+#include "huffman_walk.h"
+
+static struct RunStats stats; // --stats=json (contadores atómicos)
 
-// Estructura para pasar datos a los hilos del descompresor
-struct ThreadDataDecompressor
-{
-    struct MinHeapNode *root;
-    char *encoded_data;
-    char output_filename[512];
-};
 
-// Nodo del árbol de Huffman
-struct MinHeapNode
+// Estado de un archivo: sus bloques se reparten entre los hilos y el último
+// en terminar escribe el archivo completo
+struct FileJob
 {
-    char data;
-    struct MinHeapNode *left, *right;
+    struct FileRecord rec;
+    unsigned char *decoded;      // salida de todo el archivo
+    size_t capacity;
+    long long decoded_len;
+    uint64_t original_size;      // tamaño esperado según el índice
+    int pending;                 // bloques aún sin decodificar
+    int failed;
+    char output_filename[ARCHIVE_PATH_MAX];
 };
 
-// Información de códigos
-struct CodeInfo
+// Cola compartida de unidades (archivo, bloque) para los hilos del descompresor
+struct DecompressQueue
 {
-    char character;
-    char code[MAX_TREE_HT];
+    const struct DecodeTable *table;
+    int block_size;
+    struct FileJob *jobs;
+    int *unit_file;              // archivo de cada unidad
+    int *unit_block;             // bloque de cada unidad
+    int unit_count;
+    int next_unit;
+    pthread_mutex_t lock;
 };
 
 // Función para calcular el tiempo transcurrido en milisegundos
-long long elapsedMillis(struct timeval start, struct timeval end)
+static long long elapsedMillis(struct timeval start, struct timeval end)
 {
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
@@ -46,338 +58,281 @@ long long elapsedMillis(struct timeval start, struct timeval end)
     return seconds * 1000LL + microseconds / 1000LL;
 }
 
-// Crea un nuevo nodo
-struct MinHeapNode *newNode(char data)
-{
-    struct MinHeapNode *node = malloc(sizeof(struct MinHeapNode));
-    node->left = node->right = NULL;
-    node->data = data;
-    return node;
-}
-
-// Reconstruye el árbol de Huffman desde la tabla de códigos
-struct MinHeapNode *buildTreeFromCodes(struct CodeInfo *codes, int codeCount)
+static void write_file_job(struct FileJob *job, int index)
 {
-    struct MinHeapNode *root = newNode('$');
-
-    for (int i = 0; i < codeCount; i++)
+    if ((uint64_t)job->decoded_len != job->original_size)
+        job->failed = 1;
+    if (job->failed)
     {
-        struct MinHeapNode *current = root;
-        char *code = codes[i].code;
-
-        for (int j = 0; code[j] != '\0'; j++)
-        {
-            if (code[j] == '0')
-            {
-                if (current->left == NULL)
-                {
-                    current->left = newNode('$');
-                }
-                current = current->left;
-            }
-            else
-            {
-                if (current->right == NULL)
-                {
-                    current->right = newNode('$');
-                }
-                current = current->right;
-            }
-        }
-        current->data = codes[i].character;
+        printf("Error: Datos codificados corruptos en %s\n", job->output_filename);
+        return;
     }
-
-    return root;
-}
-
-// Convierte bytes a string binario
-char *binaryToString(FILE *inFile, int bitLength, int lastBitCount)
-{
-    int byteCount = (bitLength + 7) / 8;
-    char *binStr = malloc(bitLength + 10);
-    unsigned char *bytes = malloc(byteCount + 1);
-
-    if (!binStr || !bytes)
+    uint64_t t0 = monotonicNs();
+    FILE *outFile = fopen(job->output_filename, "wb");
+    if (!outFile)
     {
-        printf("Error: No se pudo reservar memoria\n");
-        return NULL;
+        perror(job->output_filename);
+        printf("Error: No se pudo crear %s\n", job->output_filename);
+        job->failed = 1;
+        return;
     }
-
-    size_t bytesRead = fread(bytes, 1, byteCount, inFile);
-    if (bytesRead != (size_t)byteCount)
+    size_t written = fwrite(job->decoded, 1, (size_t)job->decoded_len, outFile);
+    if (fclose(outFile) != 0 || written != (size_t)job->decoded_len)
     {
-        printf("Error: Solo se pudieron leer %zu de %d bytes\n", bytesRead, byteCount);
+        printf("Error: No se pudo escribir %s\n", job->output_filename);
+        job->failed = 1;
     }
-
-    int bitIndex = 0;
-    for (int i = 0; i < (int)bytesRead; i++)
+    else
     {
-        unsigned char byte = bytes[i];
-        int bitsToRead = 8;
-
-        if (i == (int)bytesRead - 1 && lastBitCount != 8)
-        {
-            bitsToRead = lastBitCount;
-        }
-
-        for (int j = 7; j >= 8 - bitsToRead && bitIndex < bitLength; j--)
-        {
-            binStr[bitIndex++] = ((byte >> j) & 1) ? '1' : '0';
-        }
+        statsPhase(&stats, STAT_WRITE, t0, 0, (uint64_t)job->decoded_len);
+        statsFile(&stats, index, 0, (uint64_t)job->decoded_len, monotonicNs() - t0);
+        printf("Archivo descomprimido: %s\n", job->output_filename);
     }
-
-    binStr[bitIndex] = '\0';
-    free(bytes);
-    return binStr;
 }
 
-// Decodifica usando el árbol de Huffman
-char *decode_file(struct MinHeapNode *root, char *s)
+// Función que ejecuta cada hilo: toma bloques de la cola hasta vaciarla
+static void *decompress_blocks_worker(void *arg)
 {
-    if (!root || !s)
-        return NULL;
+    struct DecompressQueue *queue = (struct DecompressQueue *)arg;
+    struct DecodeTable scratch = {0}; // tabla de los bloques que traen la suya
 
-    int len = strlen(s);
-    char *ans = malloc(len * 2 + 1);
-    struct MinHeapNode *curr = root;
-    int ansIndex = 0;
-
-    for (int i = 0; i < len; i++)
+    for (;;)
     {
-        if (s[i] == '0')
-        {
-            if (curr->left)
-                curr = curr->left;
-        }
-        else if (s[i] == '1')
-        {
-            if (curr->right)
-                curr = curr->right;
-        }
-
-        if (curr && curr->left == NULL && curr->right == NULL && curr->data != '$')
-        {
-            ans[ansIndex++] = curr->data;
-            curr = root;
-        }
-
-        if (!curr)
-        {
-            printf("Error: Árbol corrupto en posición %d\n", i);
+        pthread_mutex_lock(&queue->lock);
+        int unit = queue->next_unit++;
+        pthread_mutex_unlock(&queue->lock);
+        if (unit >= queue->unit_count)
             break;
-        }
-    }
-    ans[ansIndex] = '\0';
-    return ans;
-}
-
-// Función que ejecutará cada hilo para descomprimir un archivo
-void *process_file_decompress(void *arg)
-{
-    struct ThreadDataDecompressor *data = (struct ThreadDataDecompressor *)arg;
 
-    // Decodificar
-    char *decoded_content = decode_file(data->root, data->encoded_data);
-
-    if (decoded_content)
-    {
-        // Escribir el archivo decodificado
-        FILE *outFile = fopen(data->output_filename, "w");
-        if (outFile)
+        struct FileJob *job = &queue->jobs[queue->unit_file[unit]];
+        int b = queue->unit_block[unit];
+        size_t offset = (size_t)b * (size_t)queue->block_size;
+        long long n = -1;
+        uint64_t t0 = monotonicNs();
+        if (job->decoded)
+            n = decodeRecordRange(queue->table, &scratch, &job->rec, queue->block_size, b, b + 1,
+                                  job->decoded + offset, job->capacity - offset);
+        uint64_t packed = (job->rec.blockBits[b] + 7) / 8;
+        statsPhase(&stats, STAT_DECODE, t0, packed, n > 0 ? (uint64_t)n : 0);
+        statsFile(&stats, queue->unit_file[unit], packed, 0, monotonicNs() - t0);
+
+        pthread_mutex_lock(&queue->lock);
+        if (n < 0)
+            job->failed = 1;
+        else
+            job->decoded_len += n;
+        int last = --job->pending == 0;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (last)
         {
-            fprintf(outFile, "%s", decoded_content);
-            fclose(outFile);
-            printf("Archivo descomprimido: %s\n", data->output_filename);
+            write_file_job(job, queue->unit_file[unit]);
+            free(job->decoded);
+            job->decoded = NULL;
         }
-        free(decoded_content);
     }
-
-    free(data->encoded_data);
-    free(data);
+    freeDecodeTable(&scratch);
     return NULL;
 }
 
-int main(int argc, char *argv[])
+// Motor 'threads' (--engine=threads): una cola de bloques (archivo, bloque)
+// compartida por un pool de hilos.
+int decompressThreads(const struct DecompressOptions *options)
 {
-    if (argc != 3)
+    char **patterns = options->patterns;
+    int patternCount = options->patternCount;
+    if (statsInit(&stats, "huffman_decompressor_pthread", options->statsJson, 0) != 0)
     {
-        printf("Uso: %s <archivo_comprimido.bin> <directorio_salida>\n", argv[0]);
+        printf("ERROR: Memoria insuficiente\n");
         return 1;
     }
+    const char *archivePath = options->archivePath;
+    const char *outputDir = options->outputDir;
 
     struct timeval startTime, endTime;
     gettimeofday(&startTime, NULL);
 
-    FILE *inFile = fopen(argv[1], "rb");
-    if (!inFile)
+    struct MappedFile archive;
+    uint64_t t0 = monotonicNs();
+    if (mapFileReadOnly(archivePath, &archive, patternCount ? POSIX_MADV_RANDOM : POSIX_MADV_WILLNEED) != 0)
     {
-        printf("ERROR: No se pudo abrir el archivo %s\n", argv[1]);
+        printf("ERROR: No se pudo abrir el archivo %s\n", archivePath);
         return 1;
     }
+    statsPhase(&stats, STAT_READ, t0, archive.size, 0);
+    struct ArchiveView view = { archive.data, archive.size, 0 };
 
     // Crear directorio de salida
-    mkdir(argv[2], 0755);
-
-    // Leer cabecera
-    int fileCount, codeCount;
-    if (fread(&fileCount, sizeof(int), 1, inFile) != 1 ||
-        fread(&codeCount, sizeof(int), 1, inFile) != 1)
+    mkdir(outputDir, 0755);
+
+    int fileCount, blockSize;
+    uint8_t codeLens[HUFF_SYMBOLS];
+    struct ArchiveToc toc;
+    t0 = monotonicNs();
+    if (parseArchiveHeader(&view, &fileCount, &blockSize, codeLens) != 0 ||
+        parseArchiveToc(&view, &toc) != 0)
     {
-        printf("ERROR: No se pudo leer la cabecera\n");
-        fclose(inFile);
+        printf("ERROR: Cabecera inválida o archivo no comprimido con esta versión\n");
+        unmapFile(&archive);
         return 1;
     }
-
-    printf("Archivos a descomprimir: %d\n", fileCount);
-    printf("Códigos en tabla: %d\n", codeCount);
-
-    if (codeCount <= 0 || codeCount > MAX_CHARS)
+    if (toc.count != fileCount)
     {
-        printf("ERROR: Número de códigos inválido: %d\n", codeCount);
-        fclose(inFile);
+        printf("ERROR: El índice no coincide con la cabecera\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
         return 1;
     }
+    statsPhase(&stats, STAT_PARSE, t0, 0, 0);
 
-    // Leer tabla de códigos
-    struct CodeInfo *codes = malloc(codeCount * sizeof(struct CodeInfo));
-    for (int i = 0; i < codeCount; i++)
+    // Códigos canónicos derivados de las longitudes
+    struct HuffCode huffCodes[HUFF_SYMBOLS];
+    int codeCount = 0, maxCodeLen = 0;
+    for (int s = 0; s < HUFF_SYMBOLS; s++)
     {
-        if (fread(&codes[i].character, sizeof(char), 1, inFile) != 1)
-        {
-            printf("Error leyendo carácter %d\n", i);
-            break;
-        }
-
-        int codeLen;
-        if (fread(&codeLen, sizeof(int), 1, inFile) != 1)
-        {
-            printf("Error leyendo longitud de código %d\n", i);
-            break;
-        }
-
-        if (codeLen <= 0 || codeLen >= MAX_TREE_HT)
-        {
-            printf("Error: Longitud de código inválida: %d\n", codeLen);
-            break;
-        }
-
-        if (fread(codes[i].code, sizeof(char), codeLen, inFile) != (size_t)codeLen)
-        {
-            printf("Error leyendo código %d\n", i);
-            break;
-        }
-        codes[i].code[codeLen] = '\0';
-
-        printf("Código: '%c' -> %s\n", codes[i].character, codes[i].code);
+        if (codeLens[s] > 0) codeCount++;
+        if (codeLens[s] > maxCodeLen) maxCodeLen = codeLens[s];
     }
 
-    // Reconstruir árbol de Huffman
-    struct MinHeapNode *root = buildTreeFromCodes(codes, codeCount);
-
-    pthread_t threads[fileCount];
+    printf("Archivos a descomprimir: %d\n", fileCount);
+    printf("Códigos en tabla: %d (máx. %d bits)\n", codeCount, maxCodeLen);
 
-    // Descomprimir cada archivo en un hilo separado
-    for (int i = 0; i < fileCount; i++)
+    struct DecodeTable table;
+    t0 = monotonicNs();
+    if (assignCanonicalCodes(codeLens, huffCodes) != 0 ||
+        buildDecodeTable(&table, huffCodes) != 0)
     {
-        printf("\nLanzando hilo para archivo  %d/%d...\n", i + 1, fileCount);
-
-        // Leer nombre del archivo
-        int nameLen;
-        if (fread(&nameLen, sizeof(int), 1, inFile) != 1)
-        {
-            printf("Error leyendo longitud del nombre\n");
-            break;
-        }
+        printf("ERROR: Las longitudes de código no forman un código prefijo válido\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
+        return 1;
+    }
+    statsPhase(&stats, STAT_TABLE, t0, 0, 0);
 
-        if (nameLen <= 0 || nameLen > 1000)
-        {
-            printf("Error: Longitud de nombre inválida: %d\n", nameLen);
-            break;
-        }
+    // Leer todos los registros y preparar la salida de cada archivo
+    struct FileJob *jobs = calloc((size_t)(fileCount > 0 ? fileCount : 1), sizeof(struct FileJob));
+    if (!jobs)
+    {
+        printf("ERROR: Memoria insuficiente\n");
+        freeArchiveToc(&toc);
+        unmapFile(&archive);
+        freeDecodeTable(&table);
+        return 1;
+    }
 
-        char *filename = malloc(nameLen + 1);
-        if (fread(filename, sizeof(char), nameLen, inFile) != (size_t)nameLen)
+    // El índice lleva directamente a cada registro seleccionado
+    int loaded = 0, unitCount = 0, failed = 0;
+    for (int i = 0; i < toc.count; i++)
+    {
+        if (!tocNameSelected(toc.entries[i].name, patterns, patternCount))
+            continue;
+        struct FileJob *job = &jobs[loaded];
+        t0 = monotonicNs();
+        if (parseFileRecordAt(&view, toc.entries[i].offset, blockSize, &job->rec) != 0)
         {
-            printf("Error leyendo nombre del archivo\n");
-            free(filename);
+            printf("Error leyendo el registro del archivo %d/%d\n", i + 1, fileCount);
+            failed = 1;
             break;
         }
-        filename[nameLen] = '\0';
+        statsPhase(&stats, STAT_PARSE, t0, 0, 0);
+        job->original_size = toc.entries[i].originalSize;
+        printf("Archivo: %s, %d bloques\n", job->rec.name, job->rec.blockCount);
 
-        // Leer longitud de datos codificados
-        int encodedLen;
-        if (fread(&encodedLen, sizeof(int), 1, inFile) != 1)
+        if (prepareOutputPath(outputDir, job->rec.name, job->output_filename, sizeof(job->output_filename)) != 0)
         {
-            printf("Error leyendo longitud codificada\n");
-            free(filename);
+            printf("ERROR: Nombre de archivo no válido: %s\n", job->rec.name);
+            freeFileRecord(&job->rec);
+            failed = 1;
             break;
         }
 
-        printf("Archivo: %s, bits codificados: %d\n", filename, encodedLen);
-
-        // Calcular bytes necesarios y leer lastBitCount
-        int byteCount = (encodedLen + 7) / 8;
-        unsigned char *bytes = malloc(byteCount + 1);
-
-        if (fread(bytes, 1, byteCount, inFile) != (size_t)byteCount)
-        {
-            printf("Error leyendo datos binarios\n");
-            free(filename);
-            free(bytes);
-            break;
-        }
+        job->capacity = recordOutputCapacity(&table, &job->rec, blockSize);
+        job->decoded = malloc(job->capacity + 1);
+        job->pending = job->rec.blockCount;
+        loaded++;
+        unitCount += job->rec.blockCount;
+    }
 
-        int lastBitCount;
-        if (fread(&lastBitCount, sizeof(int), 1, inFile) != 1)
+    // Sin memoria no se decodifica nada, pero se pasa por la limpieza común
+    int outOfMemory = 0;
+    if (statsInitFiles(&stats, loaded) != 0)
+        outOfMemory = 1;
+    for (int i = 0; i < stats.fileCount; i++)
+        stats.files[i].name = jobs[i].rec.name;
+
+    struct DecompressQueue queue;
+    queue.table = &table;
+    queue.block_size = blockSize;
+    queue.jobs = jobs;
+    queue.unit_count = unitCount;
+    queue.next_unit = 0;
+    queue.unit_file = malloc((size_t)(unitCount > 0 ? unitCount : 1) * sizeof(int));
+    queue.unit_block = malloc((size_t)(unitCount > 0 ? unitCount : 1) * sizeof(int));
+    if (!queue.unit_file || !queue.unit_block)
+        outOfMemory = 1;
+    if (outOfMemory)
+    {
+        printf("ERROR: Memoria insuficiente\n");
+        failed = 1;
+        unitCount = 0;
+        queue.unit_count = 0;
+    }
+    for (int i = 0, u = 0; i < loaded && !outOfMemory; i++)
+    {
+        for (int b = 0; b < jobs[i].rec.blockCount; b++, u++)
         {
-            printf("Error leyendo lastBitCount\n");
-            free(filename);
-            free(bytes);
-            break;
+            queue.unit_file[u] = i;
+            queue.unit_block[u] = b;
         }
+        // Archivos sin bloques (vacíos) se escriben directamente
+        if (jobs[i].rec.blockCount == 0)
+            write_file_job(&jobs[i], i);
+    }
+    pthread_mutex_init(&queue.lock, NULL);
 
-        // Convertir a string binario
-        char *binaryStr = malloc(encodedLen + 10);
-        int bitIndex = 0;
-
-        for (int b = 0; b < byteCount && bitIndex < encodedLen; b++)
-        {
-            unsigned char byte = bytes[b];
-            int bitsToRead = (b == byteCount - 1) ? lastBitCount : 8;
-
-            for (int bit = 7; bit >= 8 - bitsToRead && bitIndex < encodedLen; bit--)
-            {
-                binaryStr[bitIndex++] = ((byte >> bit) & 1) ? '1' : '0';
-            }
-        }
-        binaryStr[bitIndex] = '\0';
+    // Un hilo por CPU (o los de -j), sin superar el número de bloques
+    int workers = engineJobs(options->jobs);
+    if (workers > unitCount)
+        workers = unitCount;
+    printf("\nDescomprimiendo %d bloques con %d hilos...\n", unitCount, workers);
 
-        struct ThreadDataDecompressor *data = malloc(sizeof(struct ThreadDataDecompressor));
-        data->root = root;
-        data->encoded_data = binaryStr; // string binario generado
-        sprintf(data->output_filename, "%s/%s", argv[2], filename);
+    pthread_t threads[workers > 0 ? workers : 1];
+    for (int t = 0; t < workers; t++)
+        pthread_create(&threads[t], NULL, decompress_blocks_worker, &queue);
 
-        // Crear hilo para procesar el archivo
-        pthread_create(&threads[i], NULL, process_file_decompress, data);
+    // Esperar a que todos los hilos terminen
+    for (int t = 0; t < workers; t++)
+        pthread_join(threads[t], NULL);
 
-        free(filename);
-        free(bytes);
+    pthread_mutex_destroy(&queue.lock);
+    // Los nombres apuntan a los registros, que se liberan a continuación
+    statsWriteJson(&stats, stderr);
+    if (patternCount > 0 && loaded == 0 && !failed)
+    {
+        printf("ERROR: Ningún archivo coincide con los patrones indicados\n");
+        failed = 1;
     }
-
-    // Esperar a que todos los hilos terminen
-    for (int i = 0; i < fileCount; i++)
+    for (int i = 0; i < loaded; i++)
     {
-        pthread_join(threads[i], NULL);
+        if (jobs[i].failed)
+            failed = 1;
+        free(jobs[i].decoded);
+        freeFileRecord(&jobs[i].rec);
     }
+    free(jobs);
+    freeArchiveToc(&toc);
+    free(queue.unit_file);
+    free(queue.unit_block);
 
-    fclose(inFile);
-    free(codes);
+    unmapFile(&archive);
+    freeDecodeTable(&table);
 
     gettimeofday(&endTime, NULL);
     long long totalMs = elapsedMillis(startTime, endTime);
 
-    printf("\nDescompresión completada en: %s\n", argv[2]);
+    printf("\nDescompresión completada en: %s\n", outputDir);
     printf("Tiempo total de descompresión: %lld ms\n", totalMs);
 
-    return 0;
+    statsFree(&stats);
+    return failed ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "huffman_engine.h"
+
+static const char* const engineNames[] = { "serial", "threads", "processes" };
+
+int parseEngineName(const char* name, enum Engine* engine) {
+    for (int e = ENGINE_SERIAL; e <= ENGINE_PROCESSES; e++) {
+        if (strcmp(name, engineNames[e]) == 0) {
+            *engine = (enum Engine)e;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int engineJobs(int jobs) {
+    if (jobs > 0) return jobs;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
@@ -0,0 +1,56 @@
+#ifndef HUFFMAN_ENGINE_H
+#define HUFFMAN_ENGINE_H
+
+// ---------------- Motores de ejecución ---------------
+// huffman_compressor y huffman_decompressor interpretan las opciones una
+// sola vez y las pasan al motor elegido con --engine. Los tres motores
+// escriben y leen el mismo formato (huffman_archive.h): un .bin hecho con
+// cualquiera de ellos se extrae con cualquier otro.
+enum Engine {
+    ENGINE_SERIAL,     // un solo hilo (huffman_compressor.c)
+    ENGINE_THREADS,    // pool de pthreads (huffman_compressor_pthread.c)
+    ENGINE_PROCESSES,  // workers con fork() y memoria compartida (huffman_compressor_fork.c)
+};
+
+// Motor por defecto de cada ejecutable. Los nombres antiguos
+// (huffman_compressor_fork, ..._pthread) son el mismo programa compilado
+// con otro valor.
+#ifndef DEFAULT_ENGINE
+#define DEFAULT_ENGINE ENGINE_SERIAL
+#endif
+
+struct CompressOptions {
+    const char* inputDir;
+    const char* outputPath;
+    int maxLen;       // -L: 0 = longitudes óptimas sin límite
+    int blockSize;    // -b en bytes: 0 = un flujo continuo por archivo
+    int streaming;    // -s: dos pases con buffers fijos (solo serie)
+    int adaptive;     // -a: cada bloque elige entre la tabla global y una propia
+    int jobs;         // -j: hilos o procesos, 0 = uno por CPU en línea
+    int statsJson;    // --stats=json
+};
+
+struct DecompressOptions {
+    const char* archivePath;
+    const char* outputDir;
+    char** patterns;  // -x: globs de los archivos a extraer (ninguno = todos)
+    int patternCount;
+    int jobs;
+    int statsJson;
+};
+
+// Devuelve 0 y el motor si 'name' es serial, threads o processes.
+int parseEngineName(const char* name, enum Engine* engine);
+// -j efectivo: 'jobs' o, si es 0, el número de CPUs en línea.
+int engineJobs(int jobs);
+
+// Cada función es el programa completo para su motor: devuelve el código de
+// salida y escribe los mensajes y las estadísticas como antes.
+int compressSerial(const struct CompressOptions* options);
+int compressThreads(const struct CompressOptions* options);
+int compressProcesses(const struct CompressOptions* options);
+int decompressSerial(const struct DecompressOptions* options);
+int decompressThreads(const struct DecompressOptions* options);
+int decompressProcesses(const struct DecompressOptions* options);
+
+#endif
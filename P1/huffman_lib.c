@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman_archive.h"
+#include "huffman_lib.h"
+
+// Cabecera de una trama: int64 rawBytes, tabla de longitudes, int64 bits
+#define FRAME_HEAD_MAX (8 + 1 + HUFF_SYMBOLS + 8)
+
+static void notePhase(struct RunStats* stats, enum StatPhase phase, uint64_t startNs,
+                      uint64_t bytesIn, uint64_t bytesOut) {
+    if (stats) statsPhase(stats, phase, startNs, bytesIn, bytesOut);
+}
+
+// ---------------- Contextos --------------------------
+int initHuffmanCompressor(struct HuffmanCompressor* c, int blockSize, int maxLen) {
+    memset(c, 0, sizeof(*c));
+    if (blockSize == 0) blockSize = HUFFMAN_DEFAULT_BLOCK;
+    if (blockSize < 0 || blockSize > PIPE_MAX_BLOCK) return -1;
+    if (maxLen < 0 || maxLen > HUFF_MAX_CODE_LEN) return -1;
+    c->blockSize = blockSize;
+    c->maxLen = maxLen;
+    return 0;
+}
+
+void freeHuffmanCompressor(struct HuffmanCompressor* c) {
+    // Todo el estado del compresor vive en la propia estructura
+    memset(c, 0, sizeof(*c));
+}
+
+int initHuffmanDecompressor(struct HuffmanDecompressor* d) {
+    memset(d, 0, sizeof(*d));
+    return 0;
+}
+
+void freeHuffmanDecompressor(struct HuffmanDecompressor* d) {
+    freeDecodeTable(&d->table);
+    memset(d, 0, sizeof(*d));
+}
+
+// ---------------- Tramas -----------------------------
+// Las longitudes son óptimas (o las mejores dentro del límite), así que
+// nunca codifican peor que un código fijo de ceil(log2(símbolos)) <= 8
+// bits: los datos de una trama no ocupan más que su entrada.
+size_t frameBound(size_t size) {
+    return FRAME_HEAD_MAX + size;
+}
+
+long long compressFrame(struct HuffmanCompressor* c, const unsigned char* in, size_t size,
+                        unsigned char* out, size_t outCap) {
+    if (size == 0 || size > (size_t)c->blockSize) return -1;
+
+    uint64_t t0 = monotonicNs();
+    memset(c->freq, 0, sizeof(c->freq));
+    countBytes(in, size, c->freq);
+    notePhase(c->stats, STAT_HISTOGRAM, t0, size, 0);
+
+    t0 = monotonicNs();
+    uint64_t optimalBits, limitedBits;
+    if (buildCodeLengths(c->freq, c->maxLen, c->lens, &optimalBits, &limitedBits) < 0 ||
+        assignCanonicalCodes(c->lens, c->codes) != 0)
+        return -1;
+    notePhase(c->stats, STAT_TREE, t0, 0, 0);
+
+    unsigned char table[1 + HUFF_SYMBOLS];
+    size_t tableBytes = (size_t)encodeCodeLengths(c->lens, table);
+    size_t head = 8 + tableBytes + 8;
+    if (outCap < head) return -1;
+
+    // Los datos van detrás de la cabecera, que se completa con sus bits
+    struct BitWriter bw;
+    t0 = monotonicNs();
+    initBitWriterFixed(&bw, out + head, outCap - head);
+    if (encodeBytes(c->codes, in, size, &bw) != 0) return -1;
+    int64_t bits = (int64_t)finishBitWriter(&bw, NULL);
+    if (bw.failed) return -1;
+    notePhase(c->stats, STAT_ENCODE, t0, size, bw.size);
+
+    int64_t raw = (int64_t)size;
+    memcpy(out, &raw, sizeof(int64_t));
+    memcpy(out + 8, table, tableBytes);
+    memcpy(out + 8 + tableBytes, &bits, sizeof(int64_t));
+    return (long long)(head + bw.size);
+}
+
+int decompressFrame(struct HuffmanDecompressor* d, const uint8_t lens[HUFF_SYMBOLS],
+                    const unsigned char* data, uint64_t bits, unsigned char* out,
+                    uint64_t rawBytes) {
+    uint64_t t0 = monotonicNs();
+    if (!d->haveTable || memcmp(d->lens, lens, HUFF_SYMBOLS) != 0) {
+        struct HuffCode codes[HUFF_SYMBOLS];
+        d->haveTable = 0;
+        if (assignCanonicalCodes(lens, codes) != 0 || rebuildDecodeTable(&d->table, codes) != 0)
+            return -1;
+        memcpy(d->lens, lens, HUFF_SYMBOLS);
+        d->haveTable = 1;
+        notePhase(d->stats, STAT_TABLE, t0, 0, 0);
+    }
+
+    t0 = monotonicNs();
+    size_t bytes = (size_t)((bits + 7) / 8);
+    long long n = decodeBits(&d->table, data, bytes, bits, out, (size_t)rawBytes);
+    if (n < 0 || (uint64_t)n != rawBytes) return -1;
+    notePhase(d->stats, STAT_DECODE, t0, bytes, rawBytes);
+    return 0;
+}
+
+// ---------------- Buffers completos ------------------
+size_t compressBound(size_t size, int blockSize) {
+    size_t block = blockSize > 0 ? (size_t)blockSize : HUFFMAN_DEFAULT_BLOCK;
+    size_t frames = (size + block - 1) / block;
+    return HUFFMAN_STREAM_HEADER + HUFFMAN_STREAM_END + frames * FRAME_HEAD_MAX + size;
+}
+
+long long compressBuffer(struct HuffmanCompressor* c, const void* in, size_t size,
+                         void* out, size_t outCap) {
+    const unsigned char* src = in;
+    unsigned char* dst = out;
+    if (outCap < HUFFMAN_STREAM_HEADER + HUFFMAN_STREAM_END) return -1;
+
+    memcpy(dst, PIPE_MAGIC, 4);
+    dst[4] = PIPE_VERSION;
+    size_t pos = HUFFMAN_STREAM_HEADER;
+
+    // Siempre queda sitio para la trama final
+    for (size_t done = 0; done < size;) {
+        size_t n = size - done < (size_t)c->blockSize ? size - done : (size_t)c->blockSize;
+        long long written = compressFrame(c, src + done, n, dst + pos,
+                                          outCap - pos - HUFFMAN_STREAM_END);
+        if (written < 0) return -1;
+        pos += (size_t)written;
+        done += n;
+    }
+
+    memset(dst + pos, 0, HUFFMAN_STREAM_END);
+    return (long long)(pos + HUFFMAN_STREAM_END);
+}
+
+long long decompressedSize(const void* in, size_t size) {
+    struct ArchiveView view = { in, size, 0 };
+    if (parsePipeHeader(&view) != 0) return -1;
+
+    uint8_t lens[HUFF_SYMBOLS];
+    uint64_t rawBytes, bits, total = 0;
+    const unsigned char* data;
+    int more;
+    while ((more = parsePipeFrame(&view, lens, &rawBytes, &bits, &data)) > 0) total += rawBytes;
+    if (more < 0 || view.pos != view.size) return -1;
+    return (long long)total;
+}
+
+long long decompressBuffer(struct HuffmanDecompressor* d, const void* in, size_t size,
+                           void* out, size_t outCap) {
+    struct ArchiveView view = { in, size, 0 };
+    if (parsePipeHeader(&view) != 0) return -1;
+
+    unsigned char* dst = out;
+    size_t pos = 0;
+    uint8_t lens[HUFF_SYMBOLS];
+    uint64_t rawBytes, bits;
+    const unsigned char* data;
+    int more;
+    while ((more = parsePipeFrame(&view, lens, &rawBytes, &bits, &data)) > 0) {
+        if (rawBytes > outCap - pos) return -1;
+        if (decompressFrame(d, lens, data, bits, dst + pos, rawBytes) != 0) return -1;
+        pos += (size_t)rawBytes;
+    }
+    // El flujo debe terminar justo tras la trama final
+    if (more < 0 || view.pos != view.size) return -1;
+    return (long long)pos;
+}
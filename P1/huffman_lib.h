@@ -0,0 +1,78 @@
+#ifndef HUFFMAN_LIB_H
+#define HUFFMAN_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "huffman_codec.h"
+#include "huffman_stats.h"
+
+// ---------------- libhuffman -------------------------
+// Compresión de buffer a buffer dentro del proceso, sin archivos ni
+// procesos hijos. El resultado es un flujo HUFP (ver huffman_archive.h),
+// idéntico al de 'huffman_compressor -p': cada trama de hasta blockSize
+// bytes lleva su propia tabla, así que lo comprimido con la biblioteca se
+// descomprime con 'huffman_decompressor -p' y al revés.
+//
+// Los contextos se crean una vez y se reutilizan entre llamadas; no son
+// seguros para usarse desde varios hilos a la vez (uno por hilo).
+
+#define HUFFMAN_DEFAULT_BLOCK (256 * 1024)
+
+struct HuffmanCompressor {
+    int blockSize;                        // bytes de entrada por trama
+    int maxLen;                           // límite de longitud (0 = sin límite pedido)
+    struct RunStats* stats;               // opcional: fases de cada trama
+    uint64_t freq[HUFF_SYMBOLS];
+    uint8_t lens[HUFF_SYMBOLS];
+    struct HuffCode codes[HUFF_SYMBOLS];
+};
+
+struct HuffmanDecompressor {
+    struct RunStats* stats;               // opcional
+    int haveTable;                        // 'table' corresponde a 'lens'
+    uint8_t lens[HUFF_SYMBOLS];
+    struct DecodeTable table;             // su memoria se conserva entre tramas
+};
+
+// blockSize == 0 usa HUFFMAN_DEFAULT_BLOCK. Devuelve -1 si algún parámetro
+// está fuera de rango (blockSize hasta PIPE_MAX_BLOCK, maxLen hasta 64).
+int  initHuffmanCompressor(struct HuffmanCompressor* c, int blockSize, int maxLen);
+void freeHuffmanCompressor(struct HuffmanCompressor* c);
+int  initHuffmanDecompressor(struct HuffmanDecompressor* d);
+void freeHuffmanDecompressor(struct HuffmanDecompressor* d);
+
+// ---------------- Buffers completos ------------------
+// Tamaño máximo del flujo comprimido de 'size' bytes con tramas de 'blockSize'.
+size_t compressBound(size_t size, int blockSize);
+// Comprime 'in' en un flujo completo (cabecera, tramas y fin). Devuelve los
+// bytes escritos en 'out' o -1 si falla o no caben en 'outCap'.
+long long compressBuffer(struct HuffmanCompressor* c, const void* in, size_t size,
+                         void* out, size_t outCap);
+// Bytes que ocupará el flujo descomprimido, leyendo solo las cabeceras de
+// las tramas. -1 si el flujo no es válido.
+long long decompressedSize(const void* in, size_t size);
+// Descomprime un flujo completo. Devuelve los bytes escritos o -1 si el
+// flujo no es válido o no cabe en 'outCap'.
+long long decompressBuffer(struct HuffmanDecompressor* d, const void* in, size_t size,
+                           void* out, size_t outCap);
+
+// ---------------- Tramas sueltas ---------------------
+// Para quien escribe el flujo por partes (p. ej. una tubería): la cabecera y
+// el fin son writePipeHeader/writePipeEnd o su equivalente en memoria.
+#define HUFFMAN_STREAM_HEADER 5   // "HUFP" + versión
+#define HUFFMAN_STREAM_END    8   // trama con rawBytes == 0
+
+// Cota de una trama de 'size' bytes (size <= blockSize).
+size_t frameBound(size_t size);
+// Codifica 'in' (1..blockSize bytes) como una trama. Devuelve sus bytes o -1.
+long long compressFrame(struct HuffmanCompressor* c, const unsigned char* in, size_t size,
+                        unsigned char* out, size_t outCap);
+// Decodifica los datos de una trama ya interpretada (readPipeFrame o
+// parsePipeFrame). La tabla solo se reconstruye si 'lens' cambió. Devuelve
+// 0 si se obtuvieron exactamente 'rawBytes' bytes, -1 en otro caso.
+int decompressFrame(struct HuffmanDecompressor* d, const uint8_t lens[HUFF_SYMBOLS],
+                    const unsigned char* data, uint64_t bits, unsigned char* out,
+                    uint64_t rawBytes);
+
+#endif
@@ -0,0 +1,44 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huffman_mmap.h"
+
+int mapFileReadOnly(const char* path, struct MappedFile* file, int advice) {
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        file->data = (const unsigned char*)"";
+        return 0;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // la proyección sigue válida sin el descriptor
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    posix_madvise(data, (size_t)st.st_size, advice);
+    file->data = data;
+    file->size = (size_t)st.st_size;
+    return 0;
+}
+
+void unmapFile(struct MappedFile* file) {
+    if (file->size > 0) munmap((void*)file->data, file->size);
+    memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,19 @@
+#ifndef HUFFMAN_MMAP_H
+#define HUFFMAN_MMAP_H
+
+#include <stddef.h>
+#include <sys/mman.h>  // POSIX_MADV_*
+
+// Archivo proyectado en memoria de solo lectura. Un archivo vacío no se
+// proyecta: 'data' apunta a una cadena vacía y 'size' es 0.
+struct MappedFile {
+    const unsigned char* data;
+    size_t size;
+};
+
+// Proyecta 'path' completo y aplica 'advice' (POSIX_MADV_SEQUENTIAL,
+// POSIX_MADV_RANDOM, ...). Devuelve 0 si pudo, -1 en otro caso.
+int  mapFileReadOnly(const char* path, struct MappedFile* file, int advice);
+void unmapFile(struct MappedFile* file);
+
+#endif
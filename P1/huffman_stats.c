@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "huffman_stats.h"
+
+static const char* const phaseNames[STAT_PHASES] = {
+    "scan", "read", "histogram", "tree", "encode", "parse", "table", "decode", "write",
+};
+
+uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int parseStatsFormat(const char* format) {
+    return strcmp(format, "json") == 0 ? 0 : -1;
+}
+
+// ---------------- Reserva ----------------------------
+// Con 'shared' los contadores viven en una proyección anónima compartida,
+// que los hijos de fork() heredan y actualizan en el sitio.
+static void* statsAlloc(const struct RunStats* stats, size_t size) {
+    if (!stats->shared) return calloc(1, size);
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;  // las proyecciones anónimas ya vienen a cero
+}
+
+static void statsRelease(const struct RunStats* stats, void* p, size_t size) {
+    if (!p) return;
+    if (stats->shared) munmap(p, size);
+    else free(p);
+}
+
+int statsInit(struct RunStats* stats, const char* tool, int enabled, int shared) {
+    memset(stats, 0, sizeof(*stats));
+    stats->tool = tool;
+    stats->startNs = monotonicNs();
+    if (!enabled) return 0;
+
+    stats->shared = shared;
+    stats->phase = statsAlloc(stats, STAT_PHASES * sizeof(struct PhaseStat));
+    if (!stats->phase) return -1;
+    stats->enabled = 1;
+    return 0;
+}
+
+int statsInitFiles(struct RunStats* stats, int count) {
+    if (!stats->enabled || count <= 0) return 0;
+    stats->files = statsAlloc(stats, (size_t)count * sizeof(struct FileStat));
+    if (!stats->files) return -1;
+    stats->fileCount = count;
+    return 0;
+}
+
+void statsFree(struct RunStats* stats) {
+    statsRelease(stats, stats->phase, STAT_PHASES * sizeof(struct PhaseStat));
+    statsRelease(stats, stats->files, (size_t)stats->fileCount * sizeof(struct FileStat));
+    stats->phase = NULL;
+    stats->files = NULL;
+    stats->enabled = 0;
+}
+
+// ---------------- Anotaciones ------------------------
+static void atomicMin(uint64_t* target, uint64_t value) {
+    uint64_t cur = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while ((cur == 0 || value < cur) &&
+           !__atomic_compare_exchange_n(target, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static void atomicMax(uint64_t* target, uint64_t value) {
+    uint64_t cur = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(target, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void statsPhase(struct RunStats* stats, enum StatPhase phase, uint64_t startNs,
+                uint64_t bytesIn, uint64_t bytesOut) {
+    if (!stats->enabled) return;
+    uint64_t now = monotonicNs();
+    struct PhaseStat* p = &stats->phase[phase];
+    __atomic_fetch_add(&p->ns, now - startNs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->bytesIn, bytesIn, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->bytesOut, bytesOut, __ATOMIC_RELAXED);
+    atomicMin(&p->firstNs, startNs);
+    atomicMax(&p->lastNs, now);
+}
+
+void statsFile(struct RunStats* stats, int index, uint64_t bytesIn, uint64_t bytesOut,
+               uint64_t ns) {
+    if (!stats->enabled || index < 0 || index >= stats->fileCount) return;
+    struct FileStat* f = &stats->files[index];
+    __atomic_fetch_add(&f->bytesIn, bytesIn, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&f->bytesOut, bytesOut, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&f->ns, ns, __ATOMIC_RELAXED);
+}
+
+// ---------------- Salida JSON ------------------------
+static void writeJsonString(FILE* out, const char* s) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)s; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+void statsWriteJson(const struct RunStats* stats, FILE* out) {
+    if (!stats->enabled) return;
+
+    fprintf(out, "{\"tool\": ");
+    writeJsonString(out, stats->tool);
+    fprintf(out, ", \"total_ns\": %llu, \"phases\": {",
+            (unsigned long long)(monotonicNs() - stats->startNs));
+
+    int first = 1;
+    for (int i = 0; i < STAT_PHASES; i++) {
+        const struct PhaseStat* p = &stats->phase[i];
+        if (p->calls == 0) continue;
+        fprintf(out, "%s\n  \"%s\": {\"ns\": %llu, \"span_ns\": %llu, \"calls\": %llu, "
+                     "\"bytes_in\": %llu, \"bytes_out\": %llu}",
+                first ? "" : ",", phaseNames[i], (unsigned long long)p->ns,
+                (unsigned long long)(p->lastNs - p->firstNs), (unsigned long long)p->calls,
+                (unsigned long long)p->bytesIn, (unsigned long long)p->bytesOut);
+        first = 0;
+    }
+
+    // Los archivos sin nombre (no seleccionados, p. ej. con -x) no se listan
+    fprintf(out, "\n}, \"files\": [");
+    first = 1;
+    for (int i = 0; i < stats->fileCount; i++) {
+        const struct FileStat* f = &stats->files[i];
+        if (!f->name) continue;
+        fprintf(out, "%s\n  {\"name\": ", first ? "" : ",");
+        first = 0;
+        writeJsonString(out, f->name);
+        fprintf(out, ", \"bytes_in\": %llu, \"bytes_out\": %llu, \"ns\": %llu}",
+                (unsigned long long)f->bytesIn, (unsigned long long)f->bytesOut,
+                (unsigned long long)f->ns);
+    }
+    fprintf(out, "\n]}\n");
+    fflush(out);
+}
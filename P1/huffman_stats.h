@@ -0,0 +1,73 @@
+#ifndef HUFFMAN_STATS_H
+#define HUFFMAN_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// ---------------- Estadísticas por fase --------------
+// Tiempos con reloj monótono en nanosegundos y bytes de entrada/salida de
+// cada fase y de cada archivo, para --stats=json. Las sumas son atómicas:
+// varios hilos (o procesos, con 'shared') pueden anotar a la vez. En los
+// motores paralelos 'ns' suma el tiempo de todos los trabajadores y
+// 'span_ns' es el intervalo de reloj entre la primera entrada y la última
+// salida de la fase.
+enum StatPhase {
+    STAT_SCAN,       // recorrido del directorio de entrada
+    STAT_READ,       // proyección o lectura de los archivos
+    STAT_HISTOGRAM,  // conteo de frecuencias
+    STAT_TREE,       // árbol, límite de longitudes y códigos canónicos
+    STAT_ENCODE,     // codificación y empaquetado de bits (van juntos)
+    STAT_PARSE,      // cabecera, índice y registros del .bin
+    STAT_TABLE,      // tabla de decodificación
+    STAT_DECODE,
+    STAT_WRITE,      // escritura del .bin o de los archivos de salida
+    STAT_PHASES
+};
+
+struct PhaseStat {
+    uint64_t ns;
+    uint64_t calls;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t firstNs;  // 0 = la fase no se ejecutó
+    uint64_t lastNs;
+};
+
+struct FileStat {
+    const char* name;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t ns;
+};
+
+struct RunStats {
+    int enabled;
+    int shared;              // contadores en memoria MAP_SHARED (motores fork)
+    const char* tool;
+    uint64_t startNs;
+    struct PhaseStat* phase; // STAT_PHASES entradas
+    struct FileStat* files;
+    int fileCount;
+};
+
+uint64_t monotonicNs(void);
+
+// Devuelve 0 si 'format' es un formato de --stats conocido ("json").
+int  parseStatsFormat(const char* format);
+
+// Sin 'enabled' no se reserva nada y las anotaciones no hacen nada.
+int  statsInit(struct RunStats* stats, const char* tool, int enabled, int shared);
+// Reserva los contadores de 'count' archivos. Los nombres los pone el
+// llamador; los que quedan a NULL no salen en el JSON.
+int  statsInitFiles(struct RunStats* stats, int count);
+void statsFree(struct RunStats* stats);
+
+// Anota una ejecución de la fase que empezó en 'startNs' y acaba ahora.
+void statsPhase(struct RunStats* stats, enum StatPhase phase, uint64_t startNs,
+                uint64_t bytesIn, uint64_t bytesOut);
+void statsFile(struct RunStats* stats, int index, uint64_t bytesIn, uint64_t bytesOut,
+               uint64_t ns);
+
+void statsWriteJson(const struct RunStats* stats, FILE* out);
+
+#endif
@@ -0,0 +1,248 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "huffman_archive.h"
+#include "huffman_walk.h"
+
+// ---------------- Lista de archivos ------------------
+static int appendEntry(struct FileList* list, char* path, size_t rootLen, uint64_t size) {
+    if (list->count == list->capacity) {
+        int newCap = list->capacity ? list->capacity * 2 : 256;
+        struct WalkEntry* tmp = realloc(list->entries, (size_t)newCap * sizeof(struct WalkEntry));
+        if (!tmp) return -1;
+        list->entries  = tmp;
+        list->capacity = newCap;
+    }
+    struct WalkEntry* e = &list->entries[list->count++];
+    e->path = path;
+    e->name = path + rootLen + 1;
+    e->size = size;
+    return 0;
+}
+
+void freeFileList(struct FileList* list) {
+    for (int i = 0; i < list->count; i++) free(list->entries[i].path);
+    free(list->entries);
+    memset(list, 0, sizeof(*list));
+}
+
+static int compareLargestFirst(const void* a, const void* b) {
+    const struct WalkEntry* x = a;
+    const struct WalkEntry* y = b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+void sortLargestFirst(struct FileList* list) {
+    if (list->count > 1)
+        qsort(list->entries, (size_t)list->count, sizeof(struct WalkEntry), compareLargestFirst);
+}
+
+// ---------------- Recorrido en paralelo --------------
+// Cola compartida de directorios pendientes. 'active' cuenta los hilos que
+// están leyendo un directorio: el recorrido termina cuando la cola está vacía
+// y ninguno puede añadir más.
+struct WalkQueue {
+    size_t rootLen;
+    char** dirs;
+    int count;
+    int capacity;
+    int active;
+    int failed;
+    struct FileList* out;
+
+    pthread_mutex_t lock;
+    pthread_cond_t more;
+};
+
+static int pushDir(struct WalkQueue* q, char* dir) {
+    if (q->count == q->capacity) {
+        int newCap = q->capacity ? q->capacity * 2 : 64;
+        char** tmp = realloc(q->dirs, (size_t)newCap * sizeof(char*));
+        if (!tmp) return -1;
+        q->dirs = tmp;
+        q->capacity = newCap;
+    }
+    q->dirs[q->count++] = dir;
+    return 0;
+}
+
+static char* joinPath(const char* dir, const char* name) {
+    size_t a = strlen(dir), b = strlen(name);
+    char* path = malloc(a + b + 2);
+    if (!path) return NULL;
+    memcpy(path, dir, a);
+    path[a] = '/';
+    memcpy(path + a + 1, name, b + 1);
+    return path;
+}
+
+static int isTextFile(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".txt") == 0;
+}
+
+// Lee un directorio: los subdirectorios van a la cola y los archivos se
+// acumulan en 'found', que se vuelca a la lista común de una vez.
+static int scanDir(struct WalkQueue* q, const char* dirPath, struct FileList* found) {
+    DIR* dir = opendir(dirPath);
+    if (!dir) {
+        fprintf(stderr, "Aviso: No se pudo abrir el directorio %s\n", dirPath);
+        return 0;
+    }
+    int dfd = dirfd(dir);
+    int rc = 0;
+    struct dirent* entry;
+    while (rc == 0 && (entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        // d_type evita un stat por entrada cuando el sistema de archivos lo da;
+        // los enlaces a directorios no se siguen para no entrar en ciclos
+        int isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat lst;
+            if (fstatat(dfd, name, &lst, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            isDir = S_ISDIR(lst.st_mode);
+        }
+
+        if (isDir) {
+            char* sub = joinPath(dirPath, name);
+            if (!sub) { rc = -1; break; }
+            pthread_mutex_lock(&q->lock);
+            if (pushDir(q, sub) != 0) rc = -1;
+            else pthread_cond_signal(&q->more);
+            pthread_mutex_unlock(&q->lock);
+            if (rc != 0) free(sub);
+        } else if (isTextFile(name)) {
+            struct stat st;
+            if (fstatat(dfd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+            char* path = joinPath(dirPath, name);
+            if (!path) {
+                rc = -1;
+            } else if (strlen(path) - q->rootLen - 1 > HUFF_MAX_NAME) {
+                // El archivo .bin no admite el nombre: se avisa y se salta
+                fprintf(stderr, "Aviso: Se omite %s: la ruta relativa supera %d bytes\n",
+                        path, HUFF_MAX_NAME);
+                free(path);
+            } else if (appendEntry(found, path, q->rootLen, (uint64_t)st.st_size) != 0) {
+                free(path);
+                rc = -1;
+            }
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+static void* walkWorker(void* arg) {
+    struct WalkQueue* q = arg;
+    struct FileList found = {0};
+
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (q->count == 0 && q->active > 0 && !q->failed)
+            pthread_cond_wait(&q->more, &q->lock);
+        if (q->count == 0 || q->failed) break;
+
+        char* dir = q->dirs[--q->count];
+        q->active++;
+        pthread_mutex_unlock(&q->lock);
+
+        int rc = scanDir(q, dir, &found);
+        free(dir);
+
+        pthread_mutex_lock(&q->lock);
+        q->active--;
+        if (rc != 0) q->failed = 1;
+        if (q->active == 0 && q->count == 0) pthread_cond_broadcast(&q->more);
+    }
+    pthread_cond_broadcast(&q->more);
+
+    // Una sola inserción por hilo en la lista común
+    for (int i = 0; i < found.count; i++) {
+        if (q->failed || appendEntry(q->out, found.entries[i].path, q->rootLen, found.entries[i].size) != 0) {
+            q->failed = 1;
+            free(found.entries[i].path);
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+    free(found.entries);
+    return NULL;
+}
+
+int walkDirectory(const char* root, int threads, struct FileList* list) {
+    memset(list, 0, sizeof(*list));
+
+    // La raíz se comprueba aparte para poder informar del error al llamador
+    DIR* probe = opendir(root);
+    if (!probe) return -1;
+    closedir(probe);
+
+    struct WalkQueue q;
+    memset(&q, 0, sizeof(q));
+    q.rootLen = strlen(root);
+    q.out = list;
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.more, NULL);
+
+    char* first = strdup(root);
+    if (!first || pushDir(&q, first) != 0) {
+        free(first);
+        q.failed = 1;
+    }
+
+    if (!q.failed) {
+        if (threads < 1) threads = 1;
+        pthread_t tids[threads];
+        int started = 0;
+        for (int t = 1; t < threads; t++) {
+            if (pthread_create(&tids[started], NULL, walkWorker, &q) != 0) break;
+            started++;
+        }
+        walkWorker(&q);  // el hilo actual también recorre
+        for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    }
+
+    for (int i = 0; i < q.count; i++) free(q.dirs[i]);
+    free(q.dirs);
+    pthread_cond_destroy(&q.more);
+    pthread_mutex_destroy(&q.lock);
+
+    if (q.failed) {
+        errno = ENOMEM;
+        freeFileList(list);
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------- Rutas de salida --------------------
+int prepareOutputPath(const char* outputDir, const char* name, char* out, size_t outSize) {
+    if (name[0] == '/' || name[0] == '\0') return -1;
+    for (const char* p = name; *p; ) {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 0 || (len == 2 && p[0] == '.' && p[1] == '.')) return -1;
+        p += len + (end ? 1 : 0);
+    }
+
+    int n = snprintf(out, outSize, "%s/%s", outputDir, name);
+    if (n < 0 || (size_t)n >= outSize) return -1;
+
+    // Crear los directorios intermedios de 'name'
+    size_t start = strlen(outputDir) + 1;
+    for (char* slash = strchr(out + start, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int rc = mkdir(out, 0755);
+        *slash = '/';
+        if (rc != 0 && errno != EEXIST) return -1;
+    }
+    return 0;
+}
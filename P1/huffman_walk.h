@@ -0,0 +1,38 @@
+#ifndef HUFFMAN_WALK_H
+#define HUFFMAN_WALK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------------- Recorrido de directorios -----------
+// Archivo de entrada encontrado por walkDirectory. 'name' es la ruta relativa
+// a la raíz (p. ej. "logs/a.txt") y es lo que se guarda en el archivo .bin.
+struct WalkEntry {
+    char*    path;   // ruta completa para abrirlo
+    char*    name;   // apunta dentro de 'path', tras la raíz
+    uint64_t size;
+};
+
+struct FileList {
+    struct WalkEntry* entries;
+    int count;
+    int capacity;
+};
+
+// Recorre 'root' recursivamente con 'threads' hilos (1 = en el hilo actual) y
+// añade a 'list' los archivos regulares terminados en ".txt". Los
+// subdirectorios que no se pueden abrir y los archivos cuya ruta relativa
+// supera HUFF_MAX_NAME se avisan y se saltan. Devuelve -1 si
+// no se pudo abrir la raíz o faltó memoria.
+int  walkDirectory(const char* root, int threads, struct FileList* list);
+// Ordena de mayor a menor tamaño (y por nombre a igual tamaño), para que los
+// archivos grandes se repartan primero.
+void sortLargestFirst(struct FileList* list);
+void freeFileList(struct FileList* list);
+
+// ---------------- Rutas de salida --------------------
+// Compone outputDir/name en 'out' y crea los directorios intermedios. Rechaza
+// nombres absolutos o con componentes "..". Devuelve 0 si pudo, -1 si no.
+int prepareOutputPath(const char* outputDir, const char* name, char* out, size_t outSize);
+
+#endif